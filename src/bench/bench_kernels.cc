@@ -0,0 +1,110 @@
+/*******************************************************
+                     bench_kernels.cc
+********************************************************/
+
+/*
+Micro-benchmark of the set scan kernels in kernels.h against the loops they
+replaced: findLine's valid-then-tag loop and getLRU's two passes over an
+array of 32-byte line objects.
+
+usage: ./bench_kernels [lookups]
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "../kernels.h"
+using namespace std;
+
+// the line layout and scans used before the structure-of-arrays rewrite
+struct oldLine {
+   ulong tag;
+   ulong Flags;
+   ulong seq;
+   int coherenceState;
+};
+
+static ulong oldFindLine(const oldLine *set, ulong assoc, ulong tag)
+{
+   for (ulong j = 0; j < assoc; j++)
+      if (set[j].Flags != 0 && set[j].tag == tag) return j;
+   return assoc;
+}
+
+static ulong oldGetLRU(const oldLine *set, ulong assoc, ulong currentCycle)
+{
+   ulong victim = assoc, min = currentCycle;
+   for (ulong j = 0; j < assoc; j++)
+      if (set[j].Flags == 0) return j;
+   for (ulong j = 0; j < assoc; j++)
+      if (set[j].seq <= min) { victim = j; min = set[j].seq; }
+   return victim;
+}
+
+static double nsPer(chrono::steady_clock::time_point start, ulong ops)
+{
+   return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ops;
+}
+
+int main(int argc, char *argv[])
+{
+   ulong lookups = (argc > 1) ? atol(argv[1]) : 20000000;
+   const ulong sets = 1024;
+   srand(1);
+
+   printf("%-6s %-12s %10s %10s %8s\n", "ways", "kernel", "old ns/op", "new ns/op", "speedup");
+   for (ulong assoc = 4; assoc <= 32; assoc *= 2) {
+      // same contents in both layouts; 1 in 8 sets has an invalid way
+      vector<oldLine> aos(sets * assoc);
+      ulong *tags;
+      uint16_t *seqs;
+      if (posix_memalign((void **) &tags, 64, sets * assoc * sizeof(ulong)) != 0 ||
+          posix_memalign((void **) &seqs, 64, sets * assoc * sizeof(uint16_t)) != 0) return 1;
+      for (ulong s = 0; s < sets; s++) {
+         vector<uint16_t> order(assoc);
+         for (ulong j = 0; j < assoc; j++) order[j] = j + 1;
+         for (ulong j = assoc - 1; j > 0; j--) swap(order[j], order[rand() % (j + 1)]);
+         ulong hole = (s % 8 == 0) ? rand() % assoc : assoc;
+         for (ulong j = 0; j < assoc; j++) {
+            ulong i = s * assoc + j;
+            bool valid = (j != hole);
+            aos[i].tag   = valid ? (ulong) rand() : 0;
+            aos[i].Flags = valid ? 1 : 0;
+            aos[i].seq   = order[j];
+            tags[i] = valid ? aos[i].tag : INVALID_TAG;
+            seqs[i] = valid ? order[j] : 0;
+         }
+      }
+      // 3 in 4 lookups hit
+      vector<ulong> qSet(lookups % 65536 + 65536), qTag(qSet.size());
+      for (ulong q = 0; q < qSet.size(); q++) {
+         qSet[q] = rand() % sets;
+         qTag[q] = (rand() % 4) ? aos[qSet[q] * assoc + rand() % assoc].tag : (ulong) rand();
+      }
+
+      ulong sumOld = 0, sumNew = 0, n = qSet.size();
+      chrono::steady_clock::time_point t = chrono::steady_clock::now();
+      for (ulong q = 0; q < lookups; q++) sumOld += oldFindLine(&aos[qSet[q % n] * assoc], assoc, qTag[q % n]);
+      double oldNs = nsPer(t, lookups);
+      t = chrono::steady_clock::now();
+      for (ulong q = 0; q < lookups; q++) sumNew += matchTag(&tags[qSet[q % n] * assoc], assoc, qTag[q % n]);
+      double newNs = nsPer(t, lookups);
+      printf("%-6lu %-12s %10.2f %10.2f %7.2fx%s\n", assoc, "findLine", oldNs, newNs, oldNs / newNs,
+             sumOld == sumNew ? "" : "  MISMATCH");
+
+      sumOld = sumNew = 0;
+      t = chrono::steady_clock::now();
+      for (ulong q = 0; q < lookups; q++) sumOld += oldGetLRU(&aos[qSet[q % n] * assoc], assoc, assoc);
+      oldNs = nsPer(t, lookups);
+      t = chrono::steady_clock::now();
+      for (ulong q = 0; q < lookups; q++) sumNew += minStampWay(&seqs[qSet[q % n] * assoc], assoc);
+      newNs = nsPer(t, lookups);
+      printf("%-6lu %-12s %10.2f %10.2f %7.2fx%s\n", assoc, "getLRU", oldNs, newNs, oldNs / newNs,
+             sumOld == sumNew ? "" : "  MISMATCH");
+
+      free(tags);
+      free(seqs);
+   }
+   return 0;
+}
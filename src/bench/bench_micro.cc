@@ -0,0 +1,110 @@
+/*******************************************************
+                      bench_micro.cc
+********************************************************/
+
+/*
+Micro-benchmarks of the per-access cache operations in isolation, for
+every protocol: findLine, fillLine (getLRU victim choice + install), Access and
+Snoop on a 32KB 8-way cache with 64-byte blocks. Each kernel is timed
+repeats times; the output is CSV with the mean and the standard deviation
+of ns/op over the repeats, and the mean throughput.
+
+usage: ./bench_micro [ops] [repeats] (bench/run_bench.sh runs it)
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "../cache.h"
+#include "../protocol.h"
+using namespace std;
+
+const ulong CACHE_SIZE = 32768, CACHE_ASSOC = 8, BLOCK_SIZE = 64;
+const ulong FILL_BASE = 0x100000000UL;
+
+static double nsPer(chrono::steady_clock::time_point start, ulong ops)
+{
+   return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ops;
+}
+
+static void report(const char *kernel, const char *protocol, const vector<double> &ns)
+{
+   double mean = 0, var = 0;
+   for (ulong r = 0; r < ns.size(); r++) mean += ns[r];
+   mean /= ns.size();
+   for (ulong r = 0; r < ns.size(); r++) var += (ns[r] - mean) * (ns[r] - mean);
+   double stddev = (ns.size() > 1) ? sqrt(var / (ns.size() - 1)) : 0.0;
+   printf("micro,%s,%s,1,%lu,%.3f,%.3f,%.0f\n", kernel, protocol, (ulong) ns.size(), mean, stddev, 1e9 / mean);
+}
+
+// keeps the optimizer from dropping the timed loops
+static volatile ulong sink;
+
+template <class P>
+void benchProtocol(ulong ops, ulong repeats, const vector<ulong> &addrs, const vector<uchar> &opsList)
+{
+   const ulong n = addrs.size();
+   vector<double> find, fill, access, snoop;
+   for (ulong r = 0; r < repeats; r++) {
+      ProtocolCache<P> cache(CACHE_SIZE, CACHE_ASSOC, BLOCK_SIZE);
+      // warm up: the footprint is twice the cache, so about half the lookups hit
+      for (ulong i = 0; i < n; i++) cache.Access(addrs[i], opsList[i], false);
+
+      ulong sum = 0;
+      chrono::steady_clock::time_point t = chrono::steady_clock::now();
+      for (ulong i = 0; i < ops; i++) sum += cache.findLine(addrs[i % n]);
+      find.push_back(nsPer(t, ops));
+
+      // fillLine expects a miss: stream blocks the address list never touches
+      t = chrono::steady_clock::now();
+      for (ulong i = 0; i < ops; i++) sum += cache.fillLine(FILL_BASE + i * BLOCK_SIZE);
+      fill.push_back(nsPer(t, ops));
+
+      t = chrono::steady_clock::now();
+      for (ulong i = 0; i < ops; i++) sum += cache.Access(addrs[i % n], opsList[i % n], i & 1);
+      access.push_back(nsPer(t, ops));
+
+      // a remote core's reads and writes: BusRd or the protocol's write
+      // transaction; invalidation protocols drop lines as they go, so later
+      // snoops mostly miss, as they do without a snoop filter
+      for (ulong i = 0; i < n; i++) cache.Access(addrs[i], opsList[i], false);
+      const int writeBus = P::updateBased ? BUS_UPD : BUS_RDX;
+      t = chrono::steady_clock::now();
+      for (ulong i = 0; i < ops; i++) {
+         sum += cache.Snoop(addrs[i % n], opsList[i % n], opsList[i % n] == 'w' ? writeBus : BUS_RD);
+      }
+      snoop.push_back(nsPer(t, ops));
+      sink = sum;
+   }
+   report("findLine", P::name(), find);
+   report("fillLine", P::name(), fill);
+   report("Access", P::name(), access);
+   report("Snoop", P::name(), snoop);
+}
+
+int main(int argc, char *argv[])
+{
+   ulong ops     = (argc > 1) ? atol(argv[1]) : 5000000;
+   ulong repeats = (argc > 2) ? atol(argv[2]) : 5;
+   if (ops == 0 || repeats == 0) return 1;
+
+   // a fixed random stream over twice the cache capacity, one access in four a write
+   srand(1);
+   const ulong footprint = 2 * CACHE_SIZE / BLOCK_SIZE;
+   vector<ulong> addrs(1 << 16);
+   vector<uchar> opsList(addrs.size());
+   for (ulong i = 0; i < addrs.size(); i++) {
+      addrs[i]   = 0x10000000 + (rand() % footprint) * BLOCK_SIZE + (rand() % BLOCK_SIZE);
+      opsList[i] = (rand() % 4 == 0) ? 'w' : 'r';
+   }
+
+   printf("kind,name,protocol,cores,repeats,ns_per_op,ns_per_op_stddev,ops_per_sec\n");
+   benchProtocol<MSIProtocol>(ops, repeats, addrs, opsList);
+   benchProtocol<DragonProtocol>(ops, repeats, addrs, opsList);
+   benchProtocol<MESIProtocol>(ops, repeats, addrs, opsList);
+   benchProtocol<MOESIProtocol>(ops, repeats, addrs, opsList);
+   benchProtocol<FireflyProtocol>(ops, repeats, addrs, opsList);
+   return 0;
+}
@@ -0,0 +1,64 @@
+#!/bin/sh
+# Benchmark harness, run by `make bench` from src/. Prints one CSV to stdout:
+#   kind,name,protocol,cores,repeats,ns_per_op,ns_per_op_stddev,ops_per_sec
+# kind "micro" rows come from bench_micro (ns per cache operation), kind
+# "sim" rows time the whole optimized simulator (ns per trace access, the
+# process start and trace decode included). ns_per_op_stddev is the sample
+# standard deviation over the repeats.
+#
+# Environment overrides:
+#   REPEATS      runs per configuration (3)
+#   PROTOCOLS    protocols of the end-to-end runs ("0 1 2 3 4")
+#   CORES        core counts of the generated traces ("4 8 16")
+#   PATTERNS     generated trace patterns ("random migratory")
+#   GEN_ACCESSES accesses per generated trace (2000000)
+#   MICRO_OPS    operations per micro-benchmark repeat (5000000)
+#   GEOMETRY     cache size, associativity and block size ("8192 8 64")
+
+REPEATS=${REPEATS:-3}
+PROTOCOLS=${PROTOCOLS:-"0 1 2 3 4"}
+CORES=${CORES:-"4 8 16"}
+PATTERNS=${PATTERNS:-"random migratory"}
+GEN_ACCESSES=${GEN_ACCESSES:-2000000}
+MICRO_OPS=${MICRO_OPS:-5000000}
+GEOMETRY=${GEOMETRY:-"8192 8 64"}
+SIM=./smp_cache_bench
+
+# time REPEATS runs of the simulator and print one result row
+# usage: run_sim <name> <protocol> <cores> <accesses> <trace>
+run_sim()
+{
+   times=""
+   r=0
+   while [ $r -lt $REPEATS ]; do
+      start=$(date +%s%N)
+      $SIM $GEOMETRY $3 $2 "$5" > /dev/null || { echo "$SIM failed on $5" >&2; exit 1; }
+      end=$(date +%s%N)
+      times="$times $((end - start))"
+      r=$((r + 1))
+   done
+   echo $times | awk -v name="$1" -v p="$2" -v c="$3" -v n="$4" '{
+      for (i = 1; i <= NF; i++) { ns[i] = $i / n; mean += ns[i] }
+      mean /= NF
+      for (i = 1; i <= NF; i++) var += (ns[i] - mean) ^ 2
+      sd = (NF > 1) ? sqrt(var / (NF - 1)) : 0
+      printf "sim,%s,%s,%s,%d,%.3f,%.3f,%.0f\n", name, p, c, NF, mean, sd, 1e9 / mean
+   }'
+}
+
+./bench_micro $MICRO_OPS $REPEATS || exit 1
+
+for trace in ../trace/canneal.*; do
+   accesses=$(wc -l < "$trace")
+   for p in $PROTOCOLS; do
+      run_sim "$(basename "$trace")" $p 4 $accesses "$trace"
+   done
+done
+
+for pattern in $PATTERNS; do
+   for c in $CORES; do
+      for p in $PROTOCOLS; do
+         run_sim "gen:$pattern" $p $c $GEN_ACCESSES "gen:$pattern,$c,$GEN_ACCESSES"
+      done
+   done
+done
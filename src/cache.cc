@@ -4,68 +4,76 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
+#include <vector>
 #include "cache.h"
+#include "directory.h"
+#include "classify.h"
+#include "sharing.h"
+#include "events.h"
+#include "kernels.h"
+#include "protocol.h"
 using namespace std;
 
-// Bus Transactions
-struct BusTransactions {
-   // Common transactions
-   int BusRd;
-
-   // Modified MSI transactions
-   int BusRdX;
-
-   // Dragon protocol transactions
-   int Flush;
-   int BusUpd;
-   int BusRdBusUpd;
-};
-
-BusTransactions busTxMCI = {0b0001, 0b0010, 0, 0, 0};
-BusTransactions busTxDGN = {0b1001, 0, 0b1010, 0b1100, 0b1101};
-
-// Coherence States
-struct CoherenceStates {
-   // Common states
-   int M;
+const char *protocolName(ulong protocol)
+{
+   switch (protocol) {
+      case PROTO_MSI:     return MSIProtocol::name();
+      case PROTO_DRAGON:  return DragonProtocol::name();
+      case PROTO_MESI:    return MESIProtocol::name();
+      case PROTO_MOESI:   return MOESIProtocol::name();
+      case PROTO_FIREFLY: return FireflyProtocol::name();
+      default:            return "unknown";
+   }
+}
 
-   // Only MCI states
-   int C;
-   int I;
+const char *protocolStateName(ulong protocol, int state)
+{
+   switch (protocol) {
+      case PROTO_MSI:     return state < MSIProtocol::NUM_STATES ? MSIProtocol::stateName(state) : "?";
+      case PROTO_DRAGON:  return state < DragonProtocol::NUM_STATES ? DragonProtocol::stateName(state) : "?";
+      case PROTO_MESI:    return state < MESIProtocol::NUM_STATES ? MESIProtocol::stateName(state) : "?";
+      case PROTO_MOESI:   return state < MOESIProtocol::NUM_STATES ? MOESIProtocol::stateName(state) : "?";
+      case PROTO_FIREFLY: return state < FireflyProtocol::NUM_STATES ? FireflyProtocol::stateName(state) : "?";
+      default:            return "?";
+   }
+}
 
-   // Dragon protocol States
-   int E;
-   int Sm;
-   int Sc;
-};
-CoherenceStates MCIStates = {0b0100, 0b0010, 0b0001, 0,0,0};
-CoherenceStates DGNStates = {0b11000, 0, 0, 0b10100, 0b10010, 0b10001};
+// storage for the transition tables (odr-used by the lookups)
+constexpr Transition MSIProtocol::procTable[][NUM_PROC_EVENTS];
+constexpr Transition MSIProtocol::snoopTable[][NUM_BUS_EVENTS];
+constexpr Transition DragonProtocol::procTable[][NUM_PROC_EVENTS];
+constexpr Transition DragonProtocol::snoopTable[][NUM_BUS_EVENTS];
+constexpr Transition MESIProtocol::procTable[][NUM_PROC_EVENTS];
+constexpr Transition MESIProtocol::snoopTable[][NUM_BUS_EVENTS];
+constexpr Transition MOESIProtocol::procTable[][NUM_PROC_EVENTS];
+constexpr Transition MOESIProtocol::snoopTable[][NUM_BUS_EVENTS];
+constexpr Transition FireflyProtocol::procTable[][NUM_PROC_EVENTS];
+constexpr Transition FireflyProtocol::snoopTable[][NUM_BUS_EVENTS];
 
-const char* state2String(ulong state) {
-   switch (state) {
-      case 0b11000: return "MODIFIED";
-      case 0b10100: return "EXCLUSIVE";
-      case 0b10010: return "SHARED_MODIFIED";
-      case 0b10001: return "SHARED_CLEAN";
-      default:      return "INVALID";
+int parseReplacement(const char *name)
+{
+   for (int p = REPL_LRU; p <= REPL_SRRIP; p++) {
+      if (strcmp(name, replacementName(p)) == 0) return p;
    }
+   return -1;
 }
 
-const char* busTx2String(int busTx) {
-   switch (busTx) {
-      case 0b1001: return "BusRd";
-      case 0b1010: return "Flush";
-      case 0b1100: return "BusUpd";
-      case 0b1101: return "BusRdBusUpd";
-      default:     return "NONE";
+const char *replacementName(int policy)
+{
+   switch (policy) {
+      case REPL_LRU:       return "lru";
+      case REPL_TREE_PLRU: return "tree-plru";
+      case REPL_BIT_PLRU:  return "bit-plru";
+      case REPL_SRRIP:     return "srrip";
+      default:             return "unknown";
    }
 }
 
-Cache::Cache(int s,int a,int b, ulong protocol)
+Cache::Cache(int s,int a,int b, int initialState, int repl)
 {
-   ulong i, j;
-   reads = readMisses = writes = 0; 
-   writeMisses = writeBacks = currentCycle = 0;
+   ulong i;
+   currentCycle = 0;
 
    size       = (ulong)(s);
    lineSize   = (ulong)(b);
@@ -78,7 +86,15 @@ Cache::Cache(int s,int a,int b, ulong protocol)
    //*******************//
    //initialize your counters here//
    //*******************//
-   busRdXCnt = memTxCnt = flushCnt = interventionCnt = busUpdCnt = 0;
+   memset(counters, 0, sizeof(counters));
+   directory = NULL;
+   coreId    = 0;
+   clustered = false;
+   classifier = NULL;
+   sharing    = NULL;
+   events     = NULL;
+   readWords  = writtenWords = NULL;
+   log2Word   = 0;
  
    tagMask = 0;
    for(i=0;i<log2Sets;i++)
@@ -88,451 +104,401 @@ Cache::Cache(int s,int a,int b, ulong protocol)
    }
    
    /**create a two dimentional cache, sized as cache[sets][assoc]**/ 
-   cache = new cacheLine*[sets];
+   // ways per set rounded up to a power of two, so a set's tags never
+   // straddle a 64-byte line (small sets) or start at one (large sets)
+   setStride = 1;
+   log2Stride = 0;
+   while (setStride < assoc) { setStride <<= 1; log2Stride++; }
+   policy   = repl;
+   fullMask = (assoc >= 64) ? ~(uint64_t)0 : (((uint64_t)1 << assoc) - 1);
+   if (policy != REPL_LRU && policy != REPL_SRRIP && (assoc > 64 || setStride != assoc)) {
+      printf("%s needs a power of two associativity of at most 64\n", replacementName(policy));
+      exit(1);
+   }
+
+   ulong lines = sets * setStride;
+   ulong tagBytes   = lines * sizeof(ulong);
+   ulong seqBytes   = lines * sizeof(uint16_t);
+   ulong metaBytes  = lines;
+   ulong clockBytes = (sets * sizeof(uint16_t) + metaBytes + 7) / 8 * 8 - metaBytes;   // keep setBits 8-byte aligned
+   storageBytes = tagBytes + seqBytes + metaBytes + clockBytes + sets * sizeof(uint64_t);
+   if (posix_memalign(&storage, 64, storageBytes) != 0) {
+      printf("Cache allocation failed\n");
+      exit(1);
+   }
+   tags     = (ulong *) storage;
+   seqs     = (uint16_t *)((char *) storage + tagBytes);
+   meta     = (uchar *)((char *) storage + tagBytes + seqBytes);
+   setClock = (uint16_t *)((char *) storage + tagBytes + seqBytes + metaBytes);
+   setBits  = (uint64_t *)((char *) storage + tagBytes + seqBytes + metaBytes + clockBytes);
+
+   resetState(initialState);
+}
+
+void Cache::resetState(int initialState)
+{
+   ulong i, j;
+   currentCycle = 0;
+   memset(counters, 0, sizeof(counters));
    for(i=0; i<sets; i++)
    {
-      cache[i] = new cacheLine[assoc];
-      for(j=0; j<assoc; j++) 
+      setClock[i] = 0;
+      setBits[i]  = 0;
+      for(j=0; j<setStride; j++) 
       {
-         cache[i][j].invalidate();
-         if      (protocol == 0) {cache[i][j].setCoherenceState(MCIStates.I);}
-         else if (protocol == 1) {cache[i][j].setCoherenceState(0);}
+         lineId line = i * setStride + j;
+         meta[line] = 0;
+         invalidate(line);
+         setCoherenceState(line, initialState);
+         // padding ways must never be picked as victims
+         if (j >= assoc) seqs[line] = UINT16_MAX;
       }
    }      
-   
+   if (readWords != NULL) {
+      memset(readWords, 0, sets * setStride * sizeof(uint64_t));
+      memset(writtenWords, 0, sets * setStride * sizeof(uint64_t));
+   }
+}
+
+Cache::~Cache()
+{
+   free(storage);
+   delete [] readWords;
+   delete [] writtenWords;
+   delete classifier;
 }
 
 /**you might add other parameters to Access()
 since this function is an entry point 
 to the memory hierarchy (i.e. caches)**/
-int Cache::AccessMCI(ulong addr, uchar op, ulong protocol)
+template <class P>
+int ProtocolCache<P>::Access(ulong addr, uchar op, bool C)
 {
    currentCycle++;/*per cache global counter to maintain LRU order 
                     among cache ways, updated on every cache access*/
 
-   int signal = 0;
-   #ifdef _DEBUG
-      printf("\t\ttag:%lu index:%lu\n", calcTag(addr), calcIndex(addr));
-   #endif
-         
-   if(op == 'w') writes++;
-   else          reads++;
-   cacheLine * line = findLine(addr);
-   if(line == NULL)/*miss*/
+   bool write = (op == 'w');
+   counters[write ? CNT_WRITE : CNT_READ]++;
+
+   int state;
+   evicted = INVALID_TAG;
+   lineId line = findLine(addr);
+   if (classifier != NULL) classifyAccess(calcTag(addr), line == NO_LINE);
+   if(line == NO_LINE)/*miss*/
    {
-      // Allocate a cache line
-      cacheLine *newline = fillLine(addr);
-      #ifdef _DEBUG
-         printf("\t\t***Cache miss***\n");
-         printf("\t\tsignal: %d current State: %d\n", signal, newline->getCoherenceState());
-      #endif
-      if (op == 'w') { // PrWr operation
-         #ifdef _DEBUG
-            printf("\t\t***Cache read miss***\n");
-         #endif
-         writeMisses++;
-         MemoryTxInc();
-         newline->setFlags(DIRTY);
-         // Move to M state
-         newline->setCoherenceState(MCIStates.M);
-         // Broadcast BusRdX signal
-         signal = busTxMCI.BusRdX;
-         BusRdXInc();
-         #ifdef _DEBUG
-            printf("\t\tsignal: BusRdX; current State moved to: %d\n", newline->getCoherenceState());
-         #endif
-      }
-      if (op == 'r'){ // PrRd operation
-         readMisses++;
-         MemoryTxInc();
-         // Move to C state
-         newline->setCoherenceState(MCIStates.C);
-         // Broadcast BusRd Signal
-         signal = busTxMCI.BusRd;
-         #ifdef _DEBUG
-            printf("\t\tsignal: BusRd; current State moved to: %d\n", newline->getCoherenceState());
-         #endif
-      }
+      // Allocate a cache line, it starts out in I
+      line  = fillLine(addr);
+      state = Protocol::I;
    }
    else
    {
-      #ifdef _DEBUG
-         printf("\t\t***Cache hit***\n");
-         printf("\t\tsignal: %d current State: %d\n", signal, line->getCoherenceState());
-      #endif
-      // Fetch the current coherence State. It could be either M or C
-      // Depends on whether the current line is dirty or not
-      if (line->getFlags() == DIRTY)         line->setCoherenceState(MCIStates.M);
-      else if (line->getFlags() == VALID)    line->setCoherenceState(MCIStates.C);
-      else if (line->getFlags() == INVALID)  line->setCoherenceState(MCIStates.I);
-      /**since it's a hit, update LRU and update dirty flag**/
+      /**since it's a hit, update LRU**/
       updateLRU(line);
-      if(op == 'w') { // PrWr operation
-         line->setFlags(DIRTY);
-         // Move to M state if the current state was C in case of PrWr operation
-         if (line->getCoherenceState() == MCIStates.C) {
-            line->setCoherenceState(MCIStates.M);
-         }
-         #ifdef _DEBUG
-            printf("\t\tsignal: BusRdX; current State moved to: %d\n", line->getCoherenceState());
-         #endif
-      }
-      if(op == 'r') { //PrRd operation
-         // Remain in the same state for PrRD operation
-         line->setCoherenceState(line->getCoherenceState());
-         #ifdef _DEBUG
-            printf("\t\tsignal: none; current State moved to: %d\n", line->getCoherenceState());
-         #endif
-      }
+      state = getCoherenceState(line);
    }
-   return signal;
+
+   const Transition &t = Protocol::procTable[state][(write << 1) | C];
+   setCoherenceState(line, t.next);
+   if (write) setFlags(line, DIRTY);
+   applyCounters(t.counters);
+   lastLine = line;
+   if (sharing != NULL) recordWord(line, addr, write);
+   if (events != NULL && events->wants(coreId)) {
+      if (evicted != INVALID_TAG) events->record(EVT_EVICT, coreId, calcAddr4Tag(evicted), evictedDirty);
+      events->record(EVT_ACCESS, coreId, addr, op, state, t.next);
+      if (t.bus != BUS_NONE) events->record(EVT_BUS, coreId, addr, t.bus);
+   }
+   return t.bus;
 }
 
-int Cache::AccessDGN(ulong addr, uchar op, ulong protocol, bool C)
+/*look up line*/
+lineId Cache::findLine(ulong addr)
 {
-   currentCycle++;/*per cache global counter to maintain LRU order 
-                    among cache ways, updated on every cache access*/
-   int signal = 0;
-   #ifdef _DEBUG
-      printf("\t\ttag:%lu index:%lu\n", calcTag(addr), calcIndex(addr));
-   #endif
-   if(op == 'w') writes++;
-   else          reads++;
-   
-   cacheLine * line = findLine(addr);
-   if(line == NULL)/*miss*/
-   {
-      // Allocate a cache line
-      cacheLine *newline = fillLine(addr);
-      #ifdef _DEBUG
-         printf("\t\t***Cache miss***\n");
-         printf("\t\tsignal: %d current State: %d C:%d\n", signal, newline->getCoherenceState(), C);
-      #endif
-      if(op == 'w') { // PrWrMiss;
-         writeMisses++;
-         MemoryTxInc();
-         newline->setFlags(DIRTY);
-         if(!C) {
-            // Move to M state if there are no other copies
-            newline->setCoherenceState(DGNStates.M);
-            // Broadcast BusRd signal
-            signal = busTxDGN.BusRd;
-         }
-         else {
-            // Move to Sm state if there are other copies
-            newline->setCoherenceState(DGNStates.Sm);
-            // Broadcast BusRd signal followed by BusUpd signal
-            signal = busTxDGN.BusRdBusUpd;
-            BusUpdInc();
-         }
-         #ifdef _DEBUG
-            printf("\t\tsignal: BusRdX; current State moved to: %d\n", newline->getCoherenceState());
-         #endif
-      }
-      else if (op == 'r') { // PrRdMiss
-         readMisses++;
-         MemoryTxInc();
-         if(!C) {
-            // Move to E state if there are no other copies
-            newline->setCoherenceState(DGNStates.E);
-            signal = busTxDGN.BusRd;
-         }
-         else {
-            newline->setCoherenceState(DGNStates.Sc);
-            signal = busTxDGN.BusRd;
-         }
-         #ifdef _DEBUG
-            printf("\t\tsignal: BusRd; current State moved to: %d\n", newline->getCoherenceState());
-         #endif
-      }     
-   }
-   else
-   {
-      #ifdef _DEBUG
-         printf("\t\t***Cache hit***\n");
-         printf("\t\tsignal: %d current State: %d\n", signal, line->getCoherenceState());
-      #endif
-      /**since it's a hit, update LRU and update dirty flag**/
-      updateLRU(line);
-      if(op == 'w') { // PrWr operation
-         line->setFlags(DIRTY);
-         if (line->getCoherenceState() == DGNStates.M) { // Modified state
-            line->setCoherenceState(DGNStates.M);
-         }
-         else if (line->getCoherenceState() == DGNStates.Sc) { // Shared clean state
-            signal = busTxDGN.BusUpd;
-            BusUpdInc();
-            if (!C) { line->setCoherenceState(DGNStates.M); }
-            else    { line->setCoherenceState(DGNStates.Sm);}
-            #ifdef _DEBUG
-               printf("\t\tC signal: BusUpd; current State moved to: %d\n", line->getCoherenceState());
-            #endif
-         }
-         else if (line->getCoherenceState() == DGNStates.Sm) { // Shared modified state
-            signal = busTxDGN.BusUpd;
-            BusUpdInc();
-            if(!C) {line->setCoherenceState(DGNStates.M); }
-            else   {line->setCoherenceState(DGNStates.Sm);}
-            #ifdef _DEBUG
-               printf("\t\t!C signal: BusUpd; current State moved to: %d\n", line->getCoherenceState());
-            #endif
-         }
-         else if(line->getCoherenceState() == DGNStates.E) { // Exclusive state
-            line->setCoherenceState(DGNStates.M);
-            #ifdef _DEBUG
-               printf("\t\tsignal: 0; current State moved to: %d\n", line->getCoherenceState());
-            #endif
+   lineId base = calcIndex(addr) << log2Stride;
+   ulong way   = matchTag(&tags[base], setStride, calcTag(addr));
+   return (way == setStride) ? NO_LINE : base + way;
+}
+
+/*upgrade LRU line to be MRU line (or promote it under the other policies)*/
+void Cache::updateLRU(lineId line)
+{
+   ulong set = line >> log2Stride;
+   ulong way = line & (setStride - 1);
+   switch (policy) {
+      case REPL_LRU:
+         if (setClock[set] == UINT16_MAX) renumberSet(set);
+         seqs[line] = ++setClock[set];
+         break;
+      case REPL_TREE_PLRU: {
+         // point every node on the path away from this way
+         seqs[line] = 1;
+         for (ulong node = way + setStride; node > 1; node >>= 1) {
+            if (node & 1) setBits[set] &= ~((uint64_t)1 << (node >> 1));
+            else          setBits[set] |=  ((uint64_t)1 << (node >> 1));
          }
+         break;
       }
-      else if(op == 'r') { // PrRd operation
-         // In this case the state does not change
-         line->setCoherenceState(line->getCoherenceState());
-         #ifdef _DEBUG
-            printf("\t\tsignal: 0; current State moved to: %d\n", line->getCoherenceState());
-         #endif
-      }
+      case REPL_BIT_PLRU:
+         seqs[line] = 1;
+         setBits[set] |= (uint64_t)1 << way;
+         if (setBits[set] == fullMask) setBits[set] = (uint64_t)1 << way;
+         break;
+      case REPL_SRRIP:
+         seqs[line] = 1;   // RRPV 0: near-immediate re-reference
+         break;
    }
-   
-   return signal;
 }
 
-/*look up line*/
-cacheLine * Cache::findLine(ulong addr)
+/*replacement update for a newly filled line*/
+void Cache::updateOnFill(lineId line)
 {
-   ulong i, j, tag, pos;
-   pos = assoc;
-   tag = calcTag(addr);
-   i   = calcIndex(addr);
-   for(j=0; j<assoc; j++)
-      if(cache[i][j].isValid()) {
-         if(cache[i][j].getTag() == tag)
-         {
-            pos = j; 
-            break; 
-         }
-   }
-   if(pos == assoc) {
-      return NULL;
-   }
-   else {
-      return &(cache[i][pos]); 
-   }
+   if (policy == REPL_SRRIP) seqs[line] = 3;   // RRPV 2: long re-reference interval
+   else updateLRU(line);
 }
 
-/*upgrade LRU line to be MRU line*/
-void Cache::updateLRU(cacheLine *line)
+/*LRU stamps are per set and 16 bits wide; when a set's clock runs out,
+  compact the stamps of its valid ways to 1..n keeping their order*/
+void Cache::renumberSet(ulong set)
 {
-   line->setSeq(currentCycle);  
+   ulong j, k, n = 0;
+   lineId base = set << log2Stride;
+   vector<lineId> order(assoc);
+   for (j = 0; j < assoc; j++) {
+      if (!isValid(base + j)) continue;
+      // insertion sort by stamp, sets are small
+      for (k = n; k > 0 && seqs[order[k-1]] > seqs[base + j]; k--) order[k] = order[k-1];
+      order[k] = base + j;
+      n++;
+   }
+   for (k = 0; k < n; k++) seqs[order[k]] = k + 1;
+   setClock[set] = n;
 }
 
 /*return an invalid line as LRU, if any, otherwise return LRU line*/
-cacheLine * Cache::getLRU(ulong addr)
+lineId Cache::getLRU(ulong addr)
 {
-   ulong i, j, victim, min;
-
-   victim = assoc;
-   min    = currentCycle;
-   i      = calcIndex(addr);
-   
-   for(j=0;j<assoc;j++)
-   {
-      if(cache[i][j].isValid() == 0) { 
-         return &(cache[i][j]); 
-      }   
+   lineId base = calcIndex(addr) << log2Stride;
+   // invalid ways are stamped 0 under every policy, so for true LRU this one
+   // scan finds the victim and for the others it finds any invalid way
+   ulong victim = minStampWay(&seqs[base], setStride);
+   if (policy != REPL_LRU && seqs[base + victim] != 0) {
+      victim = getVictimWay(calcIndex(addr));
    }
+   assert(victim < assoc);
+   return base + victim;
+}
 
-   for(j=0;j<assoc;j++)
-   {
-      if(cache[i][j].getSeq() <= min) { 
-         victim = j; 
-         min = cache[i][j].getSeq();}
-   } 
-
-   assert(victim != assoc);
-   
-   return &(cache[i][victim]);
+/*victim of a fully valid set under the pseudo-LRU and RRIP policies*/
+ulong Cache::getVictimWay(ulong set)
+{
+   lineId base = set << log2Stride;
+   ulong j, node, max;
+   switch (policy) {
+      case REPL_TREE_PLRU:
+         // follow the tree bits down to a leaf
+         for (node = 1; node < setStride; ) node = 2 * node + ((setBits[set] >> node) & 1);
+         return node - setStride;
+      case REPL_BIT_PLRU:
+         // a direct mapped set's only bit is always set: its one way is the victim
+         return (assoc == 1) ? 0 : __builtin_ctzll(~setBits[set] & fullMask);
+      case REPL_SRRIP:
+         // age every way until one reaches the distant RRPV (3), in one step
+         max = 0;
+         for (j = 0; j < assoc; j++) if (seqs[base + j] > max) max = seqs[base + j];
+         for (j = 0; j < assoc; j++) seqs[base + j] += 4 - max;
+         for (j = 0; j < assoc; j++) if (seqs[base + j] == 4) return j;
+   }
+   return 0;
 }
 
 /*find a victim, move it to MRU position*/
-cacheLine *Cache::findLineToReplace(ulong addr)
+lineId Cache::findLineToReplace(ulong addr)
 {
-   cacheLine * victim = getLRU(addr);
-   updateLRU(victim);
+   lineId victim = getLRU(addr);
+   updateOnFill(victim);
   
    return (victim);
 }
 
+template <class P>
+ProtocolCache<P>::ProtocolCache(int s, int a, int b, int policy) : Cache(s, a, b, Protocol::I, policy)
+{
+   lastLine = NO_LINE;
+   evicted  = INVALID_TAG;
+   for (int write = 0; write < 2; write++) {
+      silentStates[write] = 0;
+      sharedStates[write] = 0;
+      for (int state = 0; state < Protocol::NUM_STATES; state++) {
+         bool silent = (state != Protocol::I);
+         for (int C = 0; C < 2; C++) {
+            const Transition &t = Protocol::procTable[state][(write << 1) | C];
+            silent &= (t.next == state && t.bus == BUS_NONE && t.counters == 0);
+         }
+         if (silent) silentStates[write] |= 1 << state;
+         const Transition &t0 = Protocol::procTable[state][write << 1];
+         const Transition &t1 = Protocol::procTable[state][(write << 1) | 1];
+         if (t0.next != t1.next || t0.bus != t1.bus) sharedStates[write] |= 1 << state;
+      }
+   }
+}
+
 /*allocate a new line*/
-cacheLine *Cache::fillLine(ulong addr)
+template <class P>
+lineId ProtocolCache<P>::fillLine(ulong addr)
 { 
-   ulong tag;
-  
-   cacheLine *victim = findLineToReplace(addr);
-   assert(victim != 0);
+   lineId victim = findLineToReplace(addr);
+   assert(victim != NO_LINE);
    
-   // if(victim->getFlags() == DIRTY) {
-   if(victim->getCoherenceState() == MCIStates.M || victim->getCoherenceState() == DGNStates.Sm || victim->getCoherenceState() == DGNStates.M) {
+   // if(getFlags(victim) == DIRTY) {
+   evicted      = getTag(victim);
+   evictedDirty = Protocol::isDirty(getCoherenceState(victim));
+   if(evictedDirty) {
       writeBack(addr);
       MemoryTxInc();
    }
-      
-   tag = calcTag(addr);   
-   victim->setTag(tag);
-   victim->setFlags(VALID);    // check if this has to be done here or outside
+   installLine(victim, addr);
    /**note that this cache line has been already 
       upgraded to MRU in the previous function (findLineToReplace)**/
 
    return victim;
 }
 
-void Cache::SnoopMCI(ulong addr, uchar op, ulong protocol, int signal)
+/*put the block of addr into a victim way*/
+void Cache::installLine(lineId victim, ulong addr)
 {
-   cacheLine * line = findLine(addr);
-   #ifdef _DEBUG
-      ulong tag = calcTag(addr);
-      ulong index = calcIndex(addr);
-      printf("\t\ttag:%lu index:%lu\n", tag, index);
-   #endif
-   if(!(line == NULL)) { // Either M or C state
-      #ifdef _DEBUG
-         printf("\t\tsignal: %d current State: %d\n", signal, line->getCoherenceState());
-      #endif
-      // Based on whether M or C state respond to the signal
-      if (line->getCoherenceState() == MCIStates.M) {
-         #ifdef _DEBUG
-            printf("\t\tFLAG:%lu\n", line->getFlags());
-         #endif
-         if (signal == busTxMCI.BusRd || signal == busTxMCI.BusRdX) {
-            line->setCoherenceState(MCIStates.I);
-            writeBack(addr);
-            // Increment counters
-            // flush and increase memory transaction counter
-            FlushInc();
-            MemoryTxInc();
-            // invalidate and increase invalidation counter
-            InvalidateInc();
-            line->invalidate();
-         }
-         #ifdef _DEBUG
-            printf("\t\tcurrent State moved to: %d\n", line->getCoherenceState());
-         #endif
-      }
-      if (line->getCoherenceState() == MCIStates.C) {
-         #ifdef _DEBUG
-            printf("\t\tsignal: %d current State: %d\n", signal, line->getCoherenceState());
-            printf("\t\tFLAG:%lu\n", line->getFlags());
-         #endif
-         if (signal == busTxMCI.BusRd || signal == busTxMCI.BusRdX) {
-            line->setCoherenceState(MCIStates.I);
-            // Increment counters
-            // invalidate and increase invalidation counter
-            InvalidateInc();
-            line->invalidate();
-         }
-         #ifdef _DEBUG
-            printf("\t\tcurrent State moved to: %d\n", line->getCoherenceState());
-         #endif
-      }
+   ulong tag = calcTag(addr);   
+   if (directory != NULL) {
+      if (isValid(victim)) directory->removeSharer(getTag(victim), coreId);
+      directory->addSharer(tag, coreId);
    }
-   else {
-      #ifdef _DEBUG
-         printf("\t\tinitial stage current State: %d\n", 1);
-      #endif
+   setTag(victim, tag);
+   setFlags(victim, VALID);
+   if (readWords != NULL) readWords[victim] = writtenWords[victim] = 0;    // check if this has to be done here or outside
+}
+
+void Cache::classifyAccess(ulong block, bool miss)
+{
+   int cls = classifier->access(block, miss);
+   if (cls >= 0) counters[cls]++;
+}
+
+void Cache::attachSharingDetector(SharingDetector *det)
+{
+   // words of at least 4 bytes, and at most 64 of them per line
+   log2Word = 2;
+   while ((lineSize >> log2Word) > 64) log2Word++;
+   sharing      = det;
+   readWords    = new uint64_t[sets * setStride];
+   writtenWords = new uint64_t[sets * setStride];
+   memset(readWords, 0, sets * setStride * sizeof(uint64_t));
+   memset(writtenWords, 0, sets * setStride * sizeof(uint64_t));
+}
+
+void Cache::noteSharing(lineId line, ulong addr, uchar op, uint applied, bool update)
+{
+   // a read only communicates with a copy that wrote something; a read
+   // that downgrades or drops a clean copy is not sharing either way
+   if (op != 'w' && writtenWords[line] == 0) return;
+   // did the two cores communicate through the accessed word?
+   uint64_t used = (op == 'w') ? (readWords[line] | writtenWords[line]) : writtenWords[line];
+   bool trueSharing = (used & wordBit(addr)) != 0;
+   ulong block = calcTag(addr);
+   if (applied & INC_INV) {
+      sharing->record(SHARE_INV, trueSharing, block);
    }
+   else if (applied & (INC_ITV | INC_FLUSH)) {
+      sharing->record(SHARE_ITV, trueSharing, block);
+      writtenWords[line] = 0;
+   }
+   if (update) sharing->record(SHARE_UPD, trueSharing, block);
 }
 
-void Cache::SnoopDGN(ulong addr, uchar op, ulong protocol, int signal)
+/*drop a line in response to a snooped transaction*/
+void Cache::invalidateLine(lineId line, ulong addr)
 {
-   cacheLine * line = findLine(addr);
-   #ifdef _DEBUG
-      ulong tag = calcTag(addr);
-      ulong index = calcIndex(addr);
-      printf("\t\ttag:%lu index:%lu\n", tag, index);
-   #endif
-   if(line != NULL) {
-      #ifdef _DEBUG
-         printf("\t\tsignal: %d current State: %d\n", signal, line->getCoherenceState());
-      #endif
-      if (line->getCoherenceState() == DGNStates.E) { // Exclusive state
-         // only BusRd can be snooped. BusUpd can't be snooped as there are no other copies
-         if (signal == busTxDGN.BusRd) {
-            // another processor might've suffered a read miss
-            // cache line will be supplied to the requestor by main memory
-            // Move to Sc State
-            line->setCoherenceState(DGNStates.Sc);
-            InterventionInc();
-            #ifdef _DEBUG
-               printf("\t\tcurrent State moved to: %d\n", line->getCoherenceState());
-               printf("\t\tIntervention encountered %lu\n", getInterventions());
-            #endif
-         }
-      }
-      else if (line->getCoherenceState() == DGNStates.Sc) { // Shared Clean State
-         if (signal == busTxDGN.BusRd) {
-            // another processor suffered a read miss
-            // block will be supplied by the main memory or the owner
-            // remain in the same state
-            line->setCoherenceState(DGNStates.Sc);
-            #ifdef _DEBUG
-               printf("\t\tcurrent State moved to: %d\n", line->getCoherenceState());
-            #endif
-         }
-         else if (signal == busTxDGN.BusUpd) {
-            // Update the cache
-            // State remains the same
-            line->setCoherenceState(DGNStates.Sc);
-            #ifdef _DEBUG
-               printf("\t\tcurrent State moved to: %d\n", line->getCoherenceState());
-               printf("\t\tBusUpdate encountered; Cache line updated\n");
-            #endif
-         }
-      }
-      else if (line->getCoherenceState() == DGNStates.Sm) { // Shared modified state
-         // owner of the line/block
-         if (signal == busTxDGN.BusRd) {
-            line->setCoherenceState(DGNStates.Sm);
-            FlushInc();
-            writeBack(addr);
-            MemoryTxInc();
-            #ifdef _DEBUG
-               printf("\t\tcurrent State moved to: %d\n", line->getCoherenceState());
-               printf("\t\tFlush to the bus %lu\n", getFlushes());
-            #endif
-         }
-         else if (signal == busTxDGN.BusUpd) {
-            line->setCoherenceState(DGNStates.Sc);
-            // Merge the update on the cache line
-            #ifdef _DEBUG
-               printf("\t\tcurrent State moved to: %d\n", line->getCoherenceState());
-               printf("\t\tBusUpdate encountered; Cache line updated\n");
-            #endif
-         }
-      }
-      else if (line->getCoherenceState() == DGNStates.M) { // Modified state
-         // this copy is the only valid copy; only BusRd can be snooped
-         if (signal == busTxDGN.BusRd) {
-            line->setCoherenceState(DGNStates.Sm);
-            InterventionInc();
-            FlushInc();
-            writeBack(addr);
-            MemoryTxInc();
-            #ifdef _DEBUG
-               printf("\t\tcurrent State moved to: %d\n", line->getCoherenceState());
-               printf("\t\tIntervention encountered %lu\n", getInterventions());
-               printf("\t\tFlush to the bus %lu\n", getFlushes());
-            #endif
-         }
+   invalidate(line);
+   if (directory != NULL) directory->removeSharer(calcTag(addr), coreId);
+}
+
+template <class P>
+uint ProtocolCache<P>::Snoop(ulong addr, uchar op, int bus)
+{
+   lineId line = findLine(addr);
+   if (line == NO_LINE) {
+      // cache does not have the line; ignore any snoop transaction
+      return 0;
+   }
+   uint applied = 0;
+   // a transaction may carry several bus events (Dragon's BusRd + BusUpd)
+   for (; bus != 0; bus &= bus - 1) {
+      int state = getCoherenceState(line);
+      const Transition &t = Protocol::snoopTable[state][__builtin_ctz(bus)];
+      if (sharing != NULL) noteSharing(line, addr, op, t.counters, __builtin_ctz(bus) == EV_BUSUPD);
+      applyCounters(t.counters);
+      setCoherenceState(line, t.next);
+      applied |= t.counters;
+      if (events != NULL && events->wants(coreId)) events->record(EVT_SNOOP, coreId, addr, __builtin_ctz(bus), state, t.next);
+      if (t.next == Protocol::I) {
+         invalidateLine(line, addr);
+         if (classifier != NULL) classifier->invalidate(calcTag(addr));
+         break;
       }
    }
+   return applied;
+}
+
+template <class P>
+int ProtocolCache<P>::warmAccess(ulong addr, uchar op, bool C)
+{
+   currentCycle++;
+   bool write = (op == 'w');
+   int state;
+   evicted = INVALID_TAG;
+   lineId line = findLine(addr);
+   if (line == NO_LINE) {
+      line  = fillLine(addr);
+      state = Protocol::I;
+   }
    else {
-      // cache does not have the line; ignore any snoop transaction
-      #ifdef _DEBUG
-         printf("\t\tNo cache line found, Snoop has nothing to do.\n");
-      #endif
+      updateLRU(line);
+      state = getCoherenceState(line);
+   }
+   const Transition &t = Protocol::procTable[state][(write << 1) | C];
+   setCoherenceState(line, t.next);
+   if (write) setFlags(line, DIRTY);
+   lastLine = line;
+   return t.bus;
+}
+
+template <class P>
+void ProtocolCache<P>::warmSnoop(ulong addr, int bus)
+{
+   lineId line = findLine(addr);
+   if (line == NO_LINE) return;
+   for (; bus != 0; bus &= bus - 1) {
+      int next = Protocol::snoopTable[getCoherenceState(line)][__builtin_ctz(bus)].next;
+      setCoherenceState(line, next);
+      if (next == Protocol::I) {
+         invalidateLine(line, addr);
+         break;
+      }
    }
 }
 
-void Cache::printStats(ulong proc, ulong protocol)
+template <class P>
+bool ProtocolCache<P>::backInvalidate(ulong addr, bool *dirty)
+{
+   lineId line = findLine(addr);
+   if (line == NO_LINE) return false;
+   *dirty = Protocol::isDirty(getCoherenceState(line));
+   if (events != NULL && events->wants(coreId)) events->record(EVT_BACK_INVAL, coreId, addr, *dirty, getCoherenceState(line), Protocol::I);
+   setCoherenceState(line, Protocol::I);
+   invalidateLine(line, addr);
+   return true;
+}
+
+template <class P>
+int ProtocolCache<P>::printStats(ulong proc)
 { 
    printf("============ Simulation results (Cache %lu) ============\n", proc);
    /****print out the rest of statistics here.****/
@@ -544,19 +510,96 @@ void Cache::printStats(ulong proc, ulong protocol)
    printf("05. total miss rate:                            %.2f%%\n", getMissRate());
    printf("06. number of writebacks:                       %lu\n", getWB());
    printf("07. number of memory transactions:              %lu\n", getMemTx());
-   if (protocol == 0) {
+   if (!Protocol::updateBased) {
       printf("08. number of invalidations:                    %lu\n", getInvalidations());
    }
-   else if (protocol == 1) {
+   else {
       printf("08. number of interventions:                    %lu\n", getInterventions());
    }
 
    printf("09. number of flushes:                          %lu\n", getFlushes());
 
-   if (protocol == 0) {
+   if (!Protocol::updateBased) {
       printf("10. number of BusRdX:                           %lu\n", getBusRdX());
    }
-   else if (protocol == 1) {
+   else {
       printf("10. number of Bus Transactions(BusUpd):         %lu\n", getBusUpd());
    }
+   int line = 11;
+   if (Protocol::upgrades) {
+      printf("%02d. number of BusUpgr:                          %lu\n", line++, getBusUpgr());
+   }
+   if (clustered) {
+      printf("%02d. number of intra-cluster transactions:       %lu\n", line++, getIntraCluster());
+      printf("%02d. number of inter-cluster transactions:       %lu\n", line++, getInterCluster());
+   }
+   if (classifier != NULL) {
+      printf("%02d. number of compulsory misses:                %lu\n", line++, getCounter(CNT_COMPULSORY));
+      printf("%02d. number of capacity misses:                  %lu\n", line++, getCounter(CNT_CAPACITY));
+      printf("%02d. number of conflict misses:                  %lu\n", line++, getCounter(CNT_CONFLICT));
+      printf("%02d. number of coherence misses:                 %lu\n", line++, getCounter(CNT_COHERENCE));
+   }
+   return line;
 }
+
+void Cache::mergeStats(Cache *other)
+{
+   for (int c = 0; c < NUM_COUNTERS; c++) {
+      counters[c] += other->counters[c];
+   }
+}
+
+void Cache::clearCounters()
+{
+   memset(counters, 0, sizeof(counters));
+}
+
+bool Cache::saveState(FILE *fp)
+{
+   return fwrite(&currentCycle, sizeof(currentCycle), 1, fp) == 1 &&
+          fwrite(counters, sizeof(counters), 1, fp) == 1 &&
+          fwrite(storage, storageBytes, 1, fp) == 1;
+}
+
+bool Cache::loadState(FILE *fp, int savedPolicy)
+{
+   if (fread(&currentCycle, sizeof(currentCycle), 1, fp) != 1 ||
+       fread(counters, sizeof(counters), 1, fp) != 1 ||
+       fread(storage, storageBytes, 1, fp) != 1) return false;
+   if (savedPolicy != policy) rebuildReplacement(savedPolicy);
+   // the snoop filter and the word bitmaps are derived state
+   for (lineId line = 0; line < sets * setStride; line++) {
+      if (!isValid(line)) continue;
+      if (directory != NULL) directory->addSharer(tags[line], coreId);
+      if (readWords != NULL) readWords[line] = writtenWords[line] = 0;
+   }
+   return true;
+}
+
+/*refill the replacement state of every set as if its valid lines had been
+  brought in from LRU to MRU (in way order unless the checkpoint kept LRU stamps)*/
+void Cache::rebuildReplacement(int savedPolicy)
+{
+   vector<lineId> order(assoc);
+   for (ulong set = 0; set < sets; set++) {
+      lineId base = set << log2Stride;
+      ulong n = 0;
+      for (ulong j = 0; j < assoc; j++) {
+         if (!isValid(base + j)) continue;
+         ulong k = n++;
+         if (savedPolicy == REPL_LRU) {
+            for (; k > 0 && seqs[order[k-1]] > seqs[base + j]; k--) order[k] = order[k-1];
+         }
+         order[k] = base + j;
+      }
+      setClock[set] = 0;
+      setBits[set]  = 0;
+      for (ulong k = 0; k < n; k++) updateOnFill(order[k]);
+   }
+}
+
+template class ProtocolCache<MSIProtocol>;
+template class ProtocolCache<DragonProtocol>;
+template class ProtocolCache<MESIProtocol>;
+template class ProtocolCache<MOESIProtocol>;
+template class ProtocolCache<FireflyProtocol>;
@@ -7,11 +7,18 @@
 
 #include <cmath>
 #include <iostream>
+#include <stdio.h>
+#include <stdint.h>
 
 typedef unsigned long ulong;
 typedef unsigned char uchar;
 typedef unsigned int uint;
 
+class SharerDirectory;
+class MissClassifier;
+class SharingDetector;
+class EventLog;
+
 /****add new states, based on the protocol****/
 enum {
    INVALID = 0,
@@ -19,28 +26,46 @@ enum {
    DIRTY
 };
 
-class cacheLine 
-{
-protected:
-   ulong tag;
-   ulong Flags;   // 0:invalid, 1:valid, 2:dirty 
-   ulong seq;
-   // coherence state variables
-   int coherenceState;
- 
-public:
-   cacheLine()                         { tag = 0; Flags = 0; }
-   ulong getTag()                      { return tag; }
-   ulong getFlags()                    { return Flags;}
-   ulong getSeq()                      { return seq; }
-   int getCoherenceState()             { return coherenceState; }
-   void setSeq(ulong Seq)              { seq = Seq;}
-   void setFlags(ulong flags)          {  Flags = flags; }
-   void setTag(ulong a)                { tag = a; }
-   void setCoherenceState(int state)   { coherenceState = state; }
-   void invalidate()                   { tag = 0; Flags = INVALID; } //useful function
-   bool isValid()                      { return ((Flags) != INVALID); }
+/****cache counters****/
+enum {
+   CNT_READ = 0,
+   CNT_READ_MISS,
+   CNT_WRITE,
+   CNT_WRITE_MISS,
+   CNT_WRITEBACK,
+   CNT_MEMTX,
+   CNT_INVALIDATION,
+   CNT_INTERVENTION,
+   CNT_FLUSH,
+   CNT_BUSRDX,
+   CNT_BUSUPD,
+   CNT_BUSUPGR,
+   CNT_INTRA_CLUSTER,   // clustered snooping: transactions on cluster-local buses
+   CNT_INTER_CLUSTER,   // clustered snooping: transactions forwarded between clusters
+   CNT_COMPULSORY,      // miss classification, see classify.h
+   CNT_COHERENCE,
+   CNT_CONFLICT,
+   CNT_CAPACITY,
+   NUM_COUNTERS
+};
+
+/****replacement policies****/
+enum {
+   REPL_LRU = 0,     // true LRU, the reference policy
+   REPL_TREE_PLRU,   // binary tree of assoc-1 bits per set
+   REPL_BIT_PLRU,    // one MRU bit per way
+   REPL_SRRIP        // 2-bit re-reference prediction values
 };
+int parseReplacement(const char *);
+const char *replacementName(int);
+
+/*
+Lines are addressed by their index into the set/way arrays of a Cache:
+line = set * setStride + way
+*/
+typedef ulong lineId;
+const lineId NO_LINE     = ~0UL;
+const ulong  INVALID_TAG = ~0UL;  // never a real block number, so lookups need no valid check
 
 class Cache
 {
@@ -48,82 +73,233 @@ protected:
    // Cache configuration parameters
    ulong size, lineSize, assoc, sets, log2Sets, log2Blk, tagMask, numLines;
 
-   // Cache counters
-   ulong reads, readMisses, writes, writeMisses, writeBacks;
+   // Cache and coherence counters, indexed by CNT_*
+   ulong counters[NUM_COUNTERS];
 
-   //******///
-   //add coherence counters here///
-   //******///
-   ulong memTxCnt, invalidationCnt, flushCnt, busRdXCnt, interventionCnt, busUpdCnt;
+   // Cache data strcuture, a single allocation split into dense arrays:
+   // each set's tags sit in their own cache-line aligned run of setStride
+   // entries, while LRU stamps and state/flag bits are packed separately
+   void *storage;
+   ulong storageBytes;
+   ulong setStride, log2Stride;
+   ulong *tags;          // block number, INVALID_TAG if the way is invalid
+   uint16_t *seqs;       // replacement state, 0 if the way is invalid:
+                         //   LRU: stamp, larger is more recent; SRRIP: RRPV + 1; PLRU: 1
+   uchar *meta;          // coherence state << 2 | flags (0:invalid, 1:valid, 2:dirty)
+   uint16_t *setClock;   // LRU: last stamp handed out in each set
+   uint64_t *setBits;    // tree-PLRU/bit-PLRU: per-set tree or MRU bits
 
-   /*
-   Modified MSI protocol (protocol 0) -> I:001, C:010, M:100
-   Dragon protocol (protocol 1) -> M:0001, Sc:0010, Sm:0100, E:1000
-   */
+   int policy;
+   uint64_t fullMask;    // one bit per way
 
-   // Cache data strcuture
-   cacheLine **cache;
+   // Optional snoop filter shared by all caches, and this cache's core id in it
+   SharerDirectory *directory;
+   ulong coreId;
+   bool clustered;      // report the cluster traffic counters
+   MissClassifier *classifier;   // NULL: misses are not classified
+   // false-sharing analysis: words read/written per line since its fill, NULL when off
+   SharingDetector *sharing;
+   uint64_t *readWords, *writtenWords;
+   ulong log2Word;
+   EventLog *events;    // NULL: no event tracing
 
    // functions to calculate tag, index and 
    ulong calcTag(ulong addr)     { return (addr >> (log2Blk) );}
    ulong calcIndex(ulong addr)   { return ((addr >> log2Blk) & tagMask);}
    ulong calcAddr4Tag(ulong tag) { return (tag << (log2Blk));}
+
+   void installLine(lineId, ulong);
+   void invalidateLine(lineId, ulong);
+   void renumberSet(ulong);
+   void updateOnFill(lineId);
+   void rebuildReplacement(int savedPolicy);
+   ulong getVictimWay(ulong);
    
 public:
     ulong currentCycle;  
      
    // Constructor
-   Cache(int,int,int,ulong);
+   Cache(int,int,int,int initialState,int policy = REPL_LRU);
    // Destructor
-   ~Cache() { delete cache;}
+   ~Cache();
    
    // Cache operations
-   cacheLine *findLineToReplace(ulong addr);
-   cacheLine *fillLine(ulong addr);
-   cacheLine * findLine(ulong addr);
-   cacheLine * getLRU(ulong);
+   lineId findLineToReplace(ulong addr);
+   lineId findLine(ulong addr);
+   lineId getLRU(ulong);
+
+   // Per-line state
+   ulong getTag(lineId line)                    { return tags[line]; }
+   ulong getFlags(lineId line)                  { return meta[line] & 3; }
+   int getCoherenceState(lineId line)           { return meta[line] >> 2; }
+   ulong getSeq(lineId line)                    { return seqs[line]; }
+   void setFlags(lineId line, ulong flags)      { meta[line] = (meta[line] & ~3) | flags; }
+   void setTag(lineId line, ulong tag)          { tags[line] = tag; }
+   void setCoherenceState(lineId line, int s)   { meta[line] = (s << 2) | (meta[line] & 3); }
+   void invalidate(lineId line)                 { tags[line] = INVALID_TAG; seqs[line] = 0; setFlags(line, INVALID); }
+   bool isValid(lineId line)                    { return tags[line] != INVALID_TAG; }
    
    // Getter for cache statistics
-   ulong getRM()                 {return readMisses;} 
-   ulong getWM()                 {return writeMisses;} 
-   ulong getReads()              {return reads;}       
-   ulong getWrites()             {return writes;}
-   ulong getWB()                 {return writeBacks;}
-   ulong getMemTx()              {return memTxCnt;}
-   ulong getInvalidations()      {return invalidationCnt;}
-   ulong getInterventions()      {return interventionCnt;}
-   ulong getFlushes()            {return flushCnt;}
-   ulong getBusRdX()             {return busRdXCnt;}
-   ulong getBusUpd()             {return busUpdCnt;}
-   double getMissRate()          {return 100.00*(double(getRM()+getWM()))/double(getReads()+getWrites());}
+   ulong getRM()                 {return counters[CNT_READ_MISS];} 
+   ulong getWM()                 {return counters[CNT_WRITE_MISS];} 
+   ulong getReads()              {return counters[CNT_READ];}       
+   ulong getWrites()             {return counters[CNT_WRITE];}
+   ulong getWB()                 {return counters[CNT_WRITEBACK];}
+   ulong getMemTx()              {return counters[CNT_MEMTX];}
+   ulong getInvalidations()      {return counters[CNT_INVALIDATION];}
+   ulong getInterventions()      {return counters[CNT_INTERVENTION];}
+   ulong getFlushes()            {return counters[CNT_FLUSH];}
+   ulong getBusRdX()             {return counters[CNT_BUSRDX];}
+   ulong getBusUpd()             {return counters[CNT_BUSUPD];}
+   ulong getBusUpgr()            {return counters[CNT_BUSUPGR];}
+   ulong getIntraCluster()       {return counters[CNT_INTRA_CLUSTER];}
+   ulong getInterCluster()       {return counters[CNT_INTER_CLUSTER];}
+   ulong getCounter(int c)       {return counters[c];}
+   void setCounter(int c, ulong v) {counters[c] = v;}
+   ulong getNumSets()            {return sets;}
+   ulong getSetIndex(ulong addr) {return calcIndex(addr);}
+   double getMissRate()          {return (getReads()+getWrites()) ? 100.00*(double(getRM()+getWM()))/double(getReads()+getWrites()) : 0.0;}
    
    // Writeback operation
-   void writeBack(ulong) {writeBacks++;}
+   void writeBack(ulong) {counters[CNT_WRITEBACK]++;}
 
    // Increment counters
-   void MemoryTxInc()         {memTxCnt++;}
-   void InvalidateInc()       {invalidationCnt++;}
-   void InterventionInc()     {interventionCnt++;}
-   void FlushInc()            {flushCnt++;}
-   void BusRdXInc()           {busRdXCnt++;}
-   void BusUpdInc()           {busUpdCnt++;}
+   void MemoryTxInc()         {counters[CNT_MEMTX]++;}
+   void InvalidateInc()       {counters[CNT_INVALIDATION]++;}
+   void InterventionInc()     {counters[CNT_INTERVENTION]++;}
+   void FlushInc()            {counters[CNT_FLUSH]++;}
+   void BusRdXInc()           {counters[CNT_BUSRDX]++;}
+   void BusUpdInc()           {counters[CNT_BUSUPD]++;}
+   void ClusterTrafficInc(ulong intra, ulong inter) {counters[CNT_INTRA_CLUSTER] += intra; counters[CNT_INTER_CLUSTER] += inter;}
+   // apply a transition's counter updates, one bit per CNT_* counter
+   void applyCounters(uint mask) {
+      for (; mask != 0; mask &= mask - 1) counters[__builtin_ctz(mask)]++;
+   }
+
+   // Keep a snoop filter informed of every block this cache fills or drops
+   void attachDirectory(SharerDirectory *dir, ulong core) { directory = dir; coreId = core; }
+   void setClustered(bool c)     {clustered = c;}
+   void attachClassifier(MissClassifier *c) {classifier = c;}
+   void attachEventLog(EventLog *log, ulong core) {events = log; coreId = core;}
+   // Feed an access to the classifier, counting the class of a miss
+   void classifyAccess(ulong block, bool miss);
 
-   // Main access function
-   int AccessMCI(ulong,uchar,ulong);
-   int AccessDGN(ulong,uchar,ulong,bool);
+   // Track word-level sharing of every line, reporting to det
+   void attachSharingDetector(SharingDetector *det);
+   uint64_t wordBit(ulong addr)  {return ((uint64_t)1) << ((addr & (lineSize - 1)) >> log2Word);}
+   void recordWord(lineId line, ulong addr, bool write) {
+      (write ? writtenWords : readWords)[line] |= wordBit(addr);
+   }
+   // Classify a coherence event on line caused by an op access to addr
+   void noteSharing(lineId line, ulong addr, uchar op, uint applied, bool update);
+   ulong getBlock(ulong addr)    {return calcTag(addr);}
+   ulong getNumLines()           {return numLines;}
 
-   // Print cache statistics
-   void printStats(ulong,ulong);
+   // Accumulate the counters of another cache (used to merge set shards)
+   void mergeStats(Cache *);
+   void clearCounters();
+   // Empty every line and zero the counters and replacement state, keeping
+   // the allocation (the analysis hooks stay attached)
+   void resetState(int initialState);
 
-   // Update LRU information
-   void updateLRU(cacheLine *);
+   // Checkpoints: currentCycle, the counters and the whole line storage as
+   // one block. A checkpoint taken under another replacement policy keeps
+   // the lines and rebuilds the replacement state from them.
+   bool saveState(FILE *);
+   bool loadState(FILE *, int savedPolicy);
+
+   // Update replacement (LRU or policy) information on a hit
+   void updateLRU(lineId);
+};
+
+/*
+A cache running one coherence protocol, see protocol.h
+*/
+template <class P>
+class ProtocolCache : public Cache
+{
+protected:
+   // last line accessed by this core, and per operation (read, write) the
+   // states in which an access causes no bus traffic and no counter update
+   // besides reads/writes, whatever the shared line says
+   lineId lastLine;
+   uint silentStates[2];
+   // per operation, the states whose transition depends on the shared line
+   uint sharedStates[2];
+   // block evicted by the last Access (INVALID_TAG if none) and whether it was dirty
+   ulong evicted;
+   bool evictedDirty;
+
+public:
+   typedef P Protocol;
+
+   ProtocolCache(int s, int a, int b, int policy = REPL_LRU);
+
+   // Retire a repeated access to the block of the last access when it is a
+   // hit that needs no bus transaction; false if Access has to handle it.
+   // The tag check catches evictions and invalidations since that access.
+   bool fastAccess(ulong addr, uchar op)
+   {
+      if (lastLine == NO_LINE || tags[lastLine] != calcTag(addr)) return false;
+      bool write = (op == 'w');
+      if (((silentStates[write] >> getCoherenceState(lastLine)) & 1) == 0) return false;
+      currentCycle++;
+      counters[write ? CNT_WRITE : CNT_READ]++;
+      updateLRU(lastLine);
+      if (write) setFlags(lastLine, DIRTY);
+      if (classifier != NULL) classifyAccess(tags[lastLine], false);
+      if (sharing != NULL) recordWord(lastLine, addr, write);
+      return true;
+   }
+
+   // allocate a line, writing back a dirty victim
+   lineId fillLine(ulong addr);
+
+   // Functional warming (sampling): the same transitions as Access and
+   // Snoop, without counters or any analysis hooks
+   bool needsShared(ulong addr, uchar op) {
+      lineId line = findLine(addr);
+      int state = (line == NO_LINE) ? (int) Protocol::I : getCoherenceState(line);
+      return (sharedStates[op == 'w'] >> state) & 1;
+   }
+   int warmAccess(ulong addr, uchar op, bool C);
+   void warmSnoop(ulong addr, int bus);
+
+   // Main access function, C is the shared line (ignored by protocols without one)
+   int Access(ulong,uchar,bool);
 
    //******///
    //add other functions to handle bus transactions///
    //******///
-   void SnoopMCI(ulong,uchar,ulong,int);
-   void SnoopDGN(ulong,uchar,ulong,int);
+   // returns the INC_* counter updates the snoop applied
+   uint Snoop(ulong,uchar,int);
+
+   // Line evicted to make room for the last Access, false if none
+   bool getEvicted(ulong *addr, bool *dirty) {
+      *addr  = calcAddr4Tag(evicted);
+      *dirty = evictedDirty;
+      return evicted != INVALID_TAG;
+   }
+   // Drop the block of addr on behalf of an inclusive lower level, false
+   // if it is not cached; dirty tells whether its data has to be written back
+   bool backInvalidate(ulong addr, bool *dirty);
+
+   // Invalidate everything in place, as freshly constructed
+   void reset() {
+      lastLine = NO_LINE;
+      evicted  = INVALID_TAG;
+      resetState(Protocol::I);
+   }
+
+   // Restore a checkpointed state (see Cache::loadState)
+   bool loadState(FILE *fp, int savedPolicy) {
+      lastLine = NO_LINE;
+      evicted  = INVALID_TAG;
+      return Cache::loadState(fp, savedPolicy);
+   }
 
+   // Print cache statistics, returns the number of the next statistics line
+   int printStats(ulong);
 };
 
 #endif
@@ -0,0 +1,47 @@
+/*******************************************************
+                          checkpoint.cc
+********************************************************/
+
+#include <string.h>
+#include "checkpoint.h"
+
+void makeCheckpointHeader(const SimConfig &cfg, ulong accesses, CheckpointHeader *header)
+{
+   memset(header, 0, sizeof(*header));
+   memcpy(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic));
+   header->protocol    = cfg.protocol;
+   header->replacement = cfg.replacement;
+   header->cacheSize   = cfg.cacheSize;
+   header->assoc       = cfg.assoc;
+   header->blockSize   = cfg.blockSize;
+   header->numProcs    = cfg.numProcs;
+   header->llcSize     = cfg.llcSize;
+   header->llcAssoc    = cfg.llcSize != 0 ? cfg.llcAssoc : 0;
+   header->llcMode     = cfg.llcSize != 0 ? cfg.llcMode : 0;
+   header->accesses    = accesses;
+}
+
+bool readCheckpointHeader(FILE *fp, const SimConfig &cfg, CheckpointHeader *header)
+{
+   if (fread(header, sizeof(*header), 1, fp) != 1 || memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0) {
+      printf("not a checkpoint file\n");
+      return false;
+   }
+   CheckpointHeader expected;
+   makeCheckpointHeader(cfg, header->accesses, &expected);
+   if (header->protocol != expected.protocol) {
+      printf("checkpoint was taken with protocol %s\n", protocolName(header->protocol));
+      return false;
+   }
+   if (header->cacheSize != expected.cacheSize || header->assoc != expected.assoc ||
+       header->blockSize != expected.blockSize || header->numProcs != expected.numProcs) {
+      printf("checkpoint was taken with %lu-byte %lu-way L1s of %lu-byte blocks on %lu processors\n",
+             (ulong) header->cacheSize, (ulong) header->assoc, (ulong) header->blockSize, (ulong) header->numProcs);
+      return false;
+   }
+   if (header->llcSize != expected.llcSize || header->llcAssoc != expected.llcAssoc || header->llcMode != expected.llcMode) {
+      printf("checkpoint was taken with a different LLC\n");
+      return false;
+   }
+   return true;
+}
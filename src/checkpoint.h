@@ -0,0 +1,66 @@
+/*******************************************************
+                          checkpoint.h
+********************************************************/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "system.h"
+
+/*
+Checkpoint layout: CheckpointHeader, then the state of every L1 (see
+Cache::saveState) and that of the LLC, if any. A checkpoint can be
+restored into a system of the same geometry and protocol; the
+replacement policy may differ.
+*/
+const char CHECKPOINT_MAGIC[8] = {'S','M','P','C','K','P','T','1'};
+
+struct CheckpointHeader {
+   char     magic[8];
+   uint32_t protocol, replacement;
+   uint64_t cacheSize, assoc, blockSize, numProcs;
+   uint64_t llcSize, llcAssoc;
+   uint32_t llcMode, reserved;
+   uint64_t accesses;   // trace offset: the checkpoint follows this many accesses
+};
+
+void makeCheckpointHeader(const SimConfig &cfg, ulong accesses, CheckpointHeader *header);
+// Read the header of fp and check it against cfg; prints the reason and
+// returns false if the checkpoint does not fit
+bool readCheckpointHeader(FILE *fp, const SimConfig &cfg, CheckpointHeader *header);
+
+template <class P>
+bool saveCheckpoint(CacheSystem<P> *sys, const SimConfig &cfg, ulong accesses, const char *fname)
+{
+   FILE *fp = fopen(fname, "wb");
+   if (fp == NULL) return false;
+   CheckpointHeader header;
+   makeCheckpointHeader(cfg, accesses, &header);
+   bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+   for (ulong i = 0; ok && i < sys->numProcs; i++) ok = sys->caches[i]->saveState(fp);
+   if (ok && sys->llc != NULL) ok = sys->llc->saveState(fp);
+   return (fclose(fp) == 0) && ok;
+}
+
+/*
+Load a checkpoint into a freshly created system; *accesses is set to its
+trace offset. The snoop filter is rebuilt from the restored lines; bus
+timing, miss classification and sharing analysis start afresh.
+*/
+template <class P>
+bool loadCheckpoint(CacheSystem<P> *sys, const SimConfig &cfg, const char *fname, ulong *accesses)
+{
+   FILE *fp = fopen(fname, "rb");
+   if (fp == NULL) return false;
+   CheckpointHeader header;
+   bool ok = readCheckpointHeader(fp, cfg, &header);
+   for (ulong i = 0; ok && i < sys->numProcs; i++) ok = sys->caches[i]->loadState(fp, header.replacement);
+   if (ok && sys->llc != NULL) ok = sys->llc->loadState(fp, header.replacement);
+   fclose(fp);
+   *accesses = header.accesses;
+   return ok;
+}
+
+#endif
@@ -0,0 +1,151 @@
+/*******************************************************
+                          classify.cc
+********************************************************/
+
+#include <string.h>
+#include "classify.h"
+
+MissClassifier::MissClassifier(ulong numLines)
+{
+   // table: start at four slots per shadow line, it grows with the footprint
+   capacity  = 2;
+   hashShift = 63;
+   while (capacity < 4 * numLines) { capacity <<= 1; hashShift--; }
+   slotMask  = capacity - 1;
+   used      = 0;
+   keys  = new ulong[capacity];
+   node  = new uint32_t[capacity];
+   flags = new uint32_t[capacity];
+   memset(keys, 0, capacity * sizeof(ulong));
+
+   numNodes  = numLines;
+   usedNodes = 0;
+   head = tail = NO_NODE;
+   nodeBlock = new ulong[numNodes];
+   prev      = new uint32_t[numNodes];
+   next      = new uint32_t[numNodes];
+}
+
+MissClassifier::~MissClassifier()
+{
+   delete [] keys;
+   delete [] node;
+   delete [] flags;
+   delete [] nodeBlock;
+   delete [] prev;
+   delete [] next;
+}
+
+/*slot holding block, or the empty slot it would be inserted into*/
+ulong MissClassifier::findSlot(ulong block)
+{
+   ulong slot = (ulong)((block * 0x9E3779B97F4A7C15ULL) >> hashShift);
+   while (keys[slot] != 0 && keys[slot] != block + 1) {
+      slot = (slot + 1) & slotMask;
+   }
+   return slot;
+}
+
+void MissClassifier::grow()
+{
+   ulong oldCapacity = capacity;
+   ulong *oldKeys = keys;
+   uint32_t *oldNode = node, *oldFlags = flags;
+
+   capacity <<= 1;
+   hashShift--;
+   slotMask = capacity - 1;
+   keys  = new ulong[capacity];
+   node  = new uint32_t[capacity];
+   flags = new uint32_t[capacity];
+   memset(keys, 0, capacity * sizeof(ulong));
+   for (ulong i = 0; i < oldCapacity; i++) {
+      if (oldKeys[i] == 0) continue;
+      ulong slot  = findSlot(oldKeys[i] - 1);
+      keys[slot]  = oldKeys[i];
+      node[slot]  = oldNode[i];
+      flags[slot] = oldFlags[i];
+   }
+   delete [] oldKeys;
+   delete [] oldNode;
+   delete [] oldFlags;
+}
+
+ulong MissClassifier::insertSlot(ulong block, bool *inserted)
+{
+   ulong slot = findSlot(block);
+   *inserted = (keys[slot] == 0);
+   if (*inserted) {
+      if (2 * (used + 1) > capacity) {
+         grow();
+         slot = findSlot(block);
+      }
+      keys[slot]  = block + 1;
+      node[slot]  = NO_NODE;
+      flags[slot] = 0;
+      used++;
+   }
+   return slot;
+}
+
+void MissClassifier::unlink(uint32_t n)
+{
+   if (prev[n] != NO_NODE) next[prev[n]] = next[n]; else head = next[n];
+   if (next[n] != NO_NODE) prev[next[n]] = prev[n]; else tail = prev[n];
+}
+
+void MissClassifier::pushFront(uint32_t n)
+{
+   prev[n] = NO_NODE;
+   next[n] = head;
+   if (head != NO_NODE) prev[head] = n; else tail = n;
+   head = n;
+}
+
+void MissClassifier::touchShadow(ulong slot, ulong block)
+{
+   uint32_t n = node[slot];
+   if (n != NO_NODE) {
+      if (n != head) { unlink(n); pushFront(n); }
+      return;
+   }
+   if (usedNodes < numNodes) {
+      // nodes are handed out in order until the shadow cache is full
+      n = usedNodes++;
+   }
+   else {
+      // full: reuse the node of the LRU block
+      n = tail;
+      unlink(n);
+      node[findSlot(nodeBlock[n])] = NO_NODE;
+   }
+   nodeBlock[n] = block;
+   node[slot]   = n;
+   pushFront(n);
+}
+
+int MissClassifier::access(ulong block, bool miss)
+{
+   bool inserted;
+   ulong slot = insertSlot(block, &inserted);
+
+   int cls = -1;
+   if (miss) {
+      if (inserted)                         cls = CNT_COMPULSORY;
+      else if (flags[slot] & INVALIDATED)   cls = CNT_COHERENCE;
+      else if (node[slot] != NO_NODE)       cls = CNT_CONFLICT;
+      else                                  cls = CNT_CAPACITY;
+   }
+   flags[slot] &= ~INVALIDATED;
+   touchShadow(slot, block);
+   return cls;
+}
+
+/*the shadow cache keeps the block: it models capacity only, and the
+  coherence check comes first*/
+void MissClassifier::invalidate(ulong block)
+{
+   ulong slot = findSlot(block);
+   if (keys[slot] == 0) return;
+   flags[slot] |= INVALIDATED;
+}
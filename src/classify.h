@@ -0,0 +1,60 @@
+/*******************************************************
+                          classify.h
+********************************************************/
+
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+#include <stdint.h>
+#include "cache.h"
+
+/*
+Sorts the misses of one cache into compulsory, coherence, conflict and
+capacity misses:
+   compulsory  the block was never accessed by this core before
+   coherence   the block was last removed by a remote invalidation
+   conflict    a fully associative LRU cache of the same capacity would hit
+   capacity    everything else
+
+All per-block state sits in one open-addressed table (linear probing,
+grown at half load) that doubles as the infinite "ever seen" set: entries
+are never removed. The fully associative shadow cache is an intrusive
+doubly linked LRU list over a fixed pool of numLines nodes that the table
+entries point into, so every access is O(1).
+*/
+class MissClassifier
+{
+protected:
+   static const uint32_t NO_NODE     = ~(uint32_t)0;
+   static const uint32_t INVALIDATED = 1;
+
+   // block table
+   ulong *keys;          // block + 1, 0 marks an empty slot
+   uint32_t *node;       // shadow list node holding the block, NO_NODE if none
+   uint32_t *flags;
+   ulong capacity, slotMask, hashShift, used;
+
+   // shadow LRU list, head is the MRU block
+   ulong *nodeBlock;
+   uint32_t *prev, *next;
+   uint32_t head, tail, numNodes, usedNodes;
+
+   ulong findSlot(ulong block);
+   ulong insertSlot(ulong block, bool *inserted);
+   void grow();
+   void unlink(uint32_t n);
+   void pushFront(uint32_t n);
+   // make block the MRU entry of the shadow cache
+   void touchShadow(ulong slot, ulong block);
+
+public:
+   MissClassifier(ulong numLines);
+   ~MissClassifier();
+
+   // Record an access to block; for a miss returns the CNT_* class to count
+   int access(ulong block, bool miss);
+   // The block was invalidated by a snooped transaction
+   void invalidate(ulong block);
+};
+
+#endif
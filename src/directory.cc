@@ -0,0 +1,94 @@
+/*******************************************************
+                          directory.cc
+********************************************************/
+
+#include <string.h>
+#include "directory.h"
+using namespace std;
+
+SharerDirectory::SharerDirectory(ulong cores, ulong linesPerCache)
+{
+   numCores = cores;
+   numWords = (cores + 63) / 64;
+
+   // keep the load factor at or below one half
+   capacity  = 2;
+   hashShift = 63;
+   while (capacity < 2 * cores * linesPerCache) { capacity <<= 1; hashShift--; }
+   slotMask  = capacity - 1;
+
+   keys    = new ulong[capacity];
+   sharers = new uint64_t[capacity * numWords];
+   memset(keys, 0, capacity * sizeof(ulong));
+   memset(sharers, 0, capacity * numWords * sizeof(uint64_t));
+}
+
+SharerDirectory::~SharerDirectory()
+{
+   delete [] keys;
+   delete [] sharers;
+}
+
+void SharerDirectory::clear()
+{
+   memset(keys, 0, capacity * sizeof(ulong));
+   memset(sharers, 0, capacity * numWords * sizeof(uint64_t));
+}
+
+/*slot holding block, or the empty slot it would be inserted into*/
+ulong SharerDirectory::findSlot(ulong block)
+{
+   ulong slot = homeSlot(block);
+   while (keys[slot] != 0 && keys[slot] != block + 1) {
+      slot = (slot + 1) & slotMask;
+   }
+   return slot;
+}
+
+/*backward-shift deletion keeps probe sequences intact without tombstones*/
+void SharerDirectory::removeSlot(ulong slot)
+{
+   ulong hole = slot;
+   ulong next = (slot + 1) & slotMask;
+   while (keys[next] != 0) {
+      ulong home = homeSlot(keys[next] - 1);
+      // move next into the hole unless its home lies cyclically in (hole, next]
+      bool stays = (hole <= next) ? (hole < home && home <= next)
+                                  : (hole < home || home <= next);
+      if (!stays) {
+         keys[hole] = keys[next];
+         memcpy(&sharers[hole * numWords], &sharers[next * numWords], numWords * sizeof(uint64_t));
+         hole = next;
+      }
+      next = (next + 1) & slotMask;
+   }
+   keys[hole] = 0;
+   memset(&sharers[hole * numWords], 0, numWords * sizeof(uint64_t));
+}
+
+void SharerDirectory::addSharer(ulong block, ulong core)
+{
+   ulong slot = findSlot(block);
+   keys[slot] = block + 1;
+   sharers[slot * numWords + core / 64] |= ((uint64_t)1) << (core % 64);
+}
+
+void SharerDirectory::removeSharer(ulong block, ulong core)
+{
+   ulong slot = findSlot(block);
+   if (keys[slot] == 0) return;
+   uint64_t *words = &sharers[slot * numWords];
+   words[core / 64] &= ~(((uint64_t)1) << (core % 64));
+   for (ulong w = 0; w < numWords; w++) {
+      if (words[w] != 0) return;
+   }
+   removeSlot(slot);
+}
+
+bool SharerDirectory::getSharers(ulong block, uint64_t *out)
+{
+   ulong slot = findSlot(block);
+   if (keys[slot] == 0) return false;
+   memcpy(out, &sharers[slot * numWords], numWords * sizeof(uint64_t));
+   return true;
+}
@@ -0,0 +1,44 @@
+/*******************************************************
+                          directory.h
+********************************************************/
+
+#ifndef DIRECTORY_H
+#define DIRECTORY_H
+
+#include <stdint.h>
+#include "cache.h"
+
+/*
+Snoop filter: maps every block held by at least one private cache to a
+presence bitmap with one bit per core. Caches keep it in sync on fill,
+eviction and invalidation, so a transaction only has to be snooped by the
+cores whose bit is set instead of being broadcast to all of them.
+
+Blocks live in an open-addressed (linear probing) table sized for the total
+number of lines in all caches, so it never has to grow.
+*/
+class SharerDirectory
+{
+protected:
+   ulong numCores, numWords, capacity, slotMask, hashShift;
+   ulong *keys;         // block + 1, 0 marks an empty slot
+   uint64_t *sharers;   // numWords presence words per slot
+
+   ulong homeSlot(ulong block)   { return (ulong)((block * 0x9E3779B97F4A7C15ULL) >> hashShift); }
+   ulong findSlot(ulong block);
+   void removeSlot(ulong slot);
+
+public:
+   SharerDirectory(ulong cores, ulong linesPerCache);
+   ~SharerDirectory();
+
+   void addSharer(ulong block, ulong core);
+   void removeSharer(ulong block, ulong core);
+   // Copy the presence words of block into out, returns false if no core holds it
+   bool getSharers(ulong block, uint64_t *out);
+   ulong getNumWords()           { return numWords; }
+   // Forget every block
+   void clear();
+};
+
+#endif
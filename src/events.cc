@@ -0,0 +1,141 @@
+/*******************************************************
+                          events.cc
+********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "events.h"
+#include "trace.h"
+#include "protocol.h"
+
+bool parseRange(const char *text, ulong *low, ulong *high, int base)
+{
+   char *end;
+   *low = strtoul(text, &end, base);
+   if (end == text) return false;
+   *high = *low;
+   if (*end == '-') {
+      text  = end + 1;
+      *high = strtoul(text, &end, base);
+      if (end == text) return false;
+   }
+   return *end == '\0' && *low <= *high;
+}
+
+bool parseCoreList(const char *text, EventFilter &filter)
+{
+   filter.cores.assign(MAX_TRACE_CORES / 64, 0);
+   while (true) {
+      char *end;
+      ulong core = strtoul(text, &end, 10);
+      if (end == text || core >= MAX_TRACE_CORES) return false;
+      filter.cores[core / 64] |= ((uint64_t)1) << (core % 64);
+      if (*end == '\0') return true;
+      if (*end != ',') return false;
+      text = end + 1;
+   }
+}
+
+EventLog::EventLog(FILE *f, const EventFilter &flt)
+{
+   fp     = f;
+   buffer = new EventRecord[EVENT_BUFFER];
+   used   = 0;
+   filter = flt;
+   index  = ~0UL;   // the first access is number 0
+   proc   = 0;
+   active = false;
+}
+
+EventLog *EventLog::open(const char *fname, ulong protocol, ulong blockSize, const EventFilter &filter)
+{
+   FILE *f = fopen(fname, "wb");
+   if (f == NULL) return NULL;
+   EventHeader header;
+   memcpy(header.magic, EVENT_MAGIC, sizeof(header.magic));
+   header.protocol  = protocol;
+   header.blockSize = blockSize;
+   if (fwrite(&header, sizeof(header), 1, f) != 1) {
+      fclose(f);
+      return NULL;
+   }
+   return new EventLog(f, filter);
+}
+
+void EventLog::flush()
+{
+   fwrite(buffer, sizeof(EventRecord), used, fp);
+   used = 0;
+}
+
+void EventLog::close()
+{
+   if (fp == NULL) return;
+   flush();
+   fclose(fp);
+   fp = NULL;
+   delete [] buffer;
+}
+
+static void printBusMask(FILE *out, int mask)
+{
+   static const char *names[NUM_BUS_EVENTS] = {"BusRd", "BusRdX", "BusUpgr", "BusUpd"};
+   const char *sep = "";
+   for (int e = 0; e < NUM_BUS_EVENTS; e++) {
+      if (mask & (1 << e)) {
+         fprintf(out, "%s%s", sep, names[e]);
+         sep = "+";
+      }
+   }
+}
+
+bool decodeEvents(const char *fname, FILE *out)
+{
+   FILE *f = fopen(fname, "rb");
+   if (f == NULL) return false;
+   EventHeader header;
+   if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, EVENT_MAGIC, sizeof(header.magic)) != 0 ||
+       header.protocol >= NUM_PROTOCOLS) {
+      fclose(f);
+      return false;
+   }
+   ulong protocol = header.protocol;
+   fprintf(out, "protocol %s, block size %u\n", protocolName(protocol), header.blockSize);
+
+   EventRecord *records = new EventRecord[EVENT_BUFFER];
+   size_t n;
+   while ((n = fread(records, sizeof(EventRecord), EVENT_BUFFER, f)) > 0) {
+      for (size_t i = 0; i < n; i++) {
+         const EventRecord &r = records[i];
+         fprintf(out, "%lu: core %u ", (ulong) r.index, r.core);
+         switch (r.type) {
+            case EVT_ACCESS:
+               fprintf(out, "%s 0x%lx: %s -> %s\n", r.detail == 'w' ? "write" : "read", (ulong) r.addr,
+                       protocolStateName(protocol, r.from), protocolStateName(protocol, r.to));
+               break;
+            case EVT_BUS:
+               fprintf(out, "bus ");
+               printBusMask(out, r.detail);
+               fprintf(out, " 0x%lx\n", (ulong) r.addr);
+               break;
+            case EVT_SNOOP:
+               fprintf(out, "snoop ");
+               printBusMask(out, 1 << r.detail);
+               fprintf(out, " from core %u 0x%lx: %s -> %s\n", r.peer, (ulong) r.addr,
+                       protocolStateName(protocol, r.from), protocolStateName(protocol, r.to));
+               break;
+            case EVT_EVICT:
+            case EVT_BACK_INVAL:
+               fprintf(out, "%s 0x%lx%s\n", r.type == EVT_EVICT ? "evict" : "back-invalidate",
+                       (ulong) r.addr, r.detail ? " dirty" : "");
+               break;
+            default:
+               fprintf(out, "unknown event %u\n", r.type);
+               break;
+         }
+      }
+   }
+   delete [] records;
+   fclose(f);
+   return true;
+}
@@ -0,0 +1,121 @@
+/*******************************************************
+                          events.h
+********************************************************/
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include "cache.h"
+
+/*
+Binary event log: a header followed by fixed-size records, all little
+endian as written by the host. Decoded by "smp_cache events <file>".
+*/
+const char EVENT_MAGIC[8] = {'S','M','P','E','V','T','0','1'};
+
+struct EventHeader {
+   char     magic[8];
+   uint32_t protocol;    // PROTO_*
+   uint32_t blockSize;
+};
+
+enum {
+   EVT_ACCESS = 0,   // core's own access: from -> to, detail is the op
+   EVT_BUS,          // core put a transaction on the bus, detail is the BUS_* mask
+   EVT_SNOOP,        // core snooped peer's transaction: from -> to, detail is the EV_* event
+   EVT_EVICT,        // core replaced the block at addr, detail is 1 if it was dirty
+   EVT_BACK_INVAL,   // the LLC removed the block at addr from core, detail as for EVT_EVICT
+   NUM_EVENT_TYPES
+};
+
+struct EventRecord {
+   uint64_t index;       // trace access the event belongs to, from 0
+   uint64_t addr;
+   uint16_t core;
+   uint16_t peer;        // requesting core
+   uint8_t  type;        // EVT_*
+   uint8_t  detail;
+   uint8_t  from, to;    // coherence states
+};
+
+// Records buffered per log before they are written out
+const ulong EVENT_BUFFER = 4096;
+
+// Which events are kept; every bound is inclusive
+struct EventFilter {
+   std::vector<uint64_t> cores;   // bitmap of cores, empty: all
+   ulong addrLow, addrHigh;
+   ulong firstAccess, lastAccess;
+
+   EventFilter() : addrLow(0), addrHigh(~0UL), firstAccess(0), lastAccess(~0UL) {}
+};
+
+// Parse "low-high" (or a single value) in the given base
+bool parseRange(const char *, ulong *low, ulong *high, int base);
+// Parse a comma separated core list into filter.cores
+bool parseCoreList(const char *, EventFilter &filter);
+
+/*
+Event log of one simulated system. Events go into a buffer owned by the
+run's thread, which writes it out when full, so logging needs no locks.
+The filter is evaluated once per access by beginAccess; for an access
+outside the window every hook is a single flag test.
+*/
+class EventLog
+{
+protected:
+   FILE *fp;
+   EventRecord *buffer;
+   ulong used;
+   EventFilter filter;
+   ulong index;      // number of the current access
+   ulong proc;       // its requesting core
+   bool active;      // the current access passed the filter
+
+   void flush();
+
+public:
+   EventLog(FILE *, const EventFilter &);
+   ~EventLog() { close(); }
+
+   static EventLog *open(const char *fname, ulong protocol, ulong blockSize, const EventFilter &);
+
+   // Start the next trace access, requested by core
+   void beginAccess(ulong core, ulong addr)
+   {
+      index++;
+      proc   = core;
+      active = index >= filter.firstAccess && index <= filter.lastAccess &&
+               addr >= filter.addrLow && addr <= filter.addrHigh;
+   }
+   // Number the following accesses from first, e.g. after a restore
+   void seek(ulong first)  { index = first - 1; }
+   // The events of the current access may be kept
+   bool isActive()   { return active; }
+   bool wants(ulong core)
+   {
+      return active && (filter.cores.empty() || ((filter.cores[core / 64] >> (core % 64)) & 1));
+   }
+   void record(int type, ulong core, ulong addr, int detail, int from = 0, int to = 0)
+   {
+      EventRecord &r = buffer[used++];
+      r.index  = index;
+      r.addr   = addr;
+      r.core   = core;
+      r.peer   = proc;
+      r.type   = type;
+      r.detail = detail;
+      r.from   = from;
+      r.to     = to;
+      if (used == EVENT_BUFFER) flush();
+   }
+   void close();
+};
+
+// Print an event log in human readable form, false if it cannot be read
+bool decodeEvents(const char *fname, FILE *out);
+
+#endif
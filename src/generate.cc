@@ -0,0 +1,143 @@
+/*******************************************************
+                          generate.cc
+********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "generate.h"
+
+// Addresses start here; objects and buffer blocks are GEN_UNIT bytes
+const ulong GEN_BASE = 0x10000000;
+const ulong GEN_UNIT = 64;
+const ulong GEN_WORD = 4;
+// readmostly: share of accesses to the shared table, the table's share of
+// the footprint, and the write percentage of the private data
+const ulong GEN_SHARED_PERCENT  = 80;
+const ulong GEN_TABLE_FRACTION  = 16;
+const ulong GEN_PRIVATE_WRITES  = 30;
+
+static const char *patternNames[NUM_GEN_PATTERNS] = {
+   "random", "migratory", "prodcons", "readmostly", "falsesharing"
+};
+
+SyntheticTraceReader::SyntheticTraceReader(int pat, ulong cores, ulong accesses, uint64_t s, ulong bytes, ulong percent)
+{
+   pattern      = pat;
+   numCores     = cores;
+   remaining    = accesses;
+   seed         = s;
+   footprint    = bytes;
+   writePercent = percent;
+   records      = new TraceRecord[TRACE_BATCH];
+   core  = 0;
+   block = 0;
+   step  = 0;
+}
+
+SyntheticTraceReader::~SyntheticTraceReader()
+{
+   delete [] records;
+}
+
+SyntheticTraceReader *SyntheticTraceReader::create(const char *spec)
+{
+   char *text = strdup(spec);
+   char *save;
+   int pattern = -1;
+   ulong cores = 0, accesses = 0, footprint = 0, percent = ~0UL;
+   uint64_t seed = 1;
+   bool ok = true;
+   ulong field = 0;
+   for (char *tok = strtok_r(text, ",", &save); tok != NULL && ok; tok = strtok_r(NULL, ",", &save), field++) {
+      char *end = NULL;
+      if (field == 0) {
+         for (int p = 0; p < NUM_GEN_PATTERNS; p++) if (strcmp(tok, patternNames[p]) == 0) pattern = p;
+         ok = (pattern >= 0);
+         continue;
+      }
+      if      (field == 1)                        cores     = strtoul(tok, &end, 10);
+      else if (field == 2)                        accesses  = strtoul(tok, &end, 10);
+      else if (strncmp(tok, "seed=", 5) == 0)      seed      = strtoull(tok + 5, &end, 10);
+      else if (strncmp(tok, "footprint=", 10) == 0) footprint = strtoul(tok + 10, &end, 10);
+      else if (strncmp(tok, "writes=", 7) == 0)    percent   = strtoul(tok + 7, &end, 10);
+      ok = (end != NULL && *end == '\0');
+   }
+   free(text);
+   if (!ok || field < 3 || cores == 0 || cores > MAX_TRACE_CORES) return NULL;
+   // the access order of these patterns fixes their write mix
+   if (percent != ~0UL && (pattern == GEN_MIGRATORY || pattern == GEN_PRODCONS)) return NULL;
+
+   // per-pattern defaults
+   if (footprint == 0) footprint = (pattern == GEN_FALSESHARING) ? 4096 : (pattern == GEN_READMOSTLY) ? (1 << 16) : (1 << 20);
+   if (percent == ~0UL) percent = (pattern == GEN_READMOSTLY) ? 2 : (pattern == GEN_FALSESHARING) ? 50 : 30;
+   if (footprint < GEN_UNIT || percent > 100) return NULL;
+   return new SyntheticTraceReader(pattern, cores, accesses, seed, footprint, percent);
+}
+
+TraceRecord SyntheticTraceReader::generate()
+{
+   switch (pattern) {
+      case GEN_MIGRATORY: {
+         // a visit reads and then writes two words of an object; the next
+         // visit picks a random object and core, so objects move between cores
+         if (step == 0) {
+            core  = below(numCores);
+            block = below(footprint / GEN_UNIT);
+         }
+         ulong s = step;
+         step = (step + 1) & 3;
+         return TraceRecord::make(core, (s & 1) ? 'w' : 'r', GEN_BASE + block * GEN_UNIT + (s >> 1) * GEN_WORD);
+      }
+      case GEN_PRODCONS: {
+         // the producer writes every word of a buffer block, then the next
+         // core reads them all; both move on to the next block
+         const ulong words = GEN_UNIT / GEN_WORD;
+         ulong s = step++;
+         ulong addr = GEN_BASE + block * GEN_UNIT + (s % words) * GEN_WORD;
+         bool produce = (s < words);
+         TraceRecord r = TraceRecord::make(produce ? core : (core + 1) % numCores, produce ? 'w' : 'r', addr);
+         if (step == 2 * words) {
+            step  = 0;
+            block = (block + 1) % (footprint / GEN_UNIT);
+            core  = (core + 1) % numCores;
+         }
+         return r;
+      }
+      case GEN_FALSESHARING: {
+         // line i holds word c of every core c
+         ulong stride = GEN_UNIT;
+         while (stride < numCores * GEN_WORD) stride <<= 1;
+         ulong lines = footprint / stride;
+         if (lines == 0) lines = 1;
+         ulong c = below(numCores);
+         return TraceRecord::make(c, writes() ? 'w' : 'r', GEN_BASE + below(lines) * stride + c * GEN_WORD);
+      }
+      case GEN_READMOSTLY: {
+         // every core mostly reads a shared table that is rarely written, and
+         // otherwise works on its own slice of the rest of the footprint
+         ulong c = below(numCores);
+         ulong table = footprint / GEN_TABLE_FRACTION / GEN_UNIT * GEN_UNIT;
+         if (table == 0) table = GEN_UNIT;
+         if (below(100) < GEN_SHARED_PERCENT) {
+            return TraceRecord::make(c, writes() ? 'w' : 'r', GEN_BASE + below(table / GEN_WORD) * GEN_WORD);
+         }
+         ulong slice = (footprint > table) ? (footprint - table) / numCores / GEN_UNIT * GEN_UNIT : 0;
+         if (slice == 0) slice = GEN_UNIT;
+         ulong addr = GEN_BASE + table + c * slice + below(slice / GEN_WORD) * GEN_WORD;
+         return TraceRecord::make(c, (below(100) < GEN_PRIVATE_WRITES) ? 'w' : 'r', addr);
+      }
+      default: {
+         ulong c = below(numCores);
+         return TraceRecord::make(c, writes() ? 'w' : 'r', GEN_BASE + below(footprint / GEN_WORD) * GEN_WORD);
+      }
+   }
+}
+
+ulong SyntheticTraceReader::nextBatch(const TraceRecord **batch)
+{
+   ulong n = (remaining < TRACE_BATCH) ? remaining : TRACE_BATCH;
+   for (ulong i = 0; i < n; i++) records[i] = generate();
+   remaining -= n;
+   *batch = records;
+   return n;
+}
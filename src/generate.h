@@ -0,0 +1,65 @@
+/*******************************************************
+                          generate.h
+********************************************************/
+
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <stdint.h>
+#include "trace.h"
+
+// Prefix of a trace file name that selects the synthetic generator
+const char GENERATOR_PREFIX[] = "gen:";
+
+enum {
+   GEN_RANDOM = 0,     // uniformly random words of the footprint
+   GEN_MIGRATORY,      // objects read then written by one core after another
+   GEN_PRODCONS,       // one core fills a buffer block, the next one reads it
+   GEN_READMOSTLY,     // shared table read by all, rarely written, plus private data
+   GEN_FALSESHARING,   // every core uses its own word of shared blocks
+   NUM_GEN_PATTERNS
+};
+
+/*
+Synthetic trace: "gen:<pattern>,<cores>,<accesses>[,seed=S][,footprint=BYTES][,writes=PCT]"
+with pattern one of random, migratory, prodcons, readmostly, falsesharing.
+Accesses are produced batch by batch from a splitmix64 stream, so a spec
+always yields the same trace, of any length, without touching the disk.
+writes is the write percentage of random and falsesharing, and of the
+shared table of readmostly;
+migratory and prodcons have a fixed read/write order and reject it.
+*/
+class SyntheticTraceReader : public TraceReader
+{
+protected:
+   int pattern;
+   ulong numCores, remaining, footprint, writePercent;
+   uint64_t seed;
+   TraceRecord *records;
+
+   // pattern state
+   ulong core, block, step;
+
+   uint64_t next()
+   {
+      uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+   }
+   // uniform in [0, n)
+   ulong below(ulong n)   { return (ulong)(((unsigned __int128) next() * n) >> 64); }
+   bool writes()          { return below(100) < writePercent; }
+   TraceRecord generate();
+
+public:
+   SyntheticTraceReader(int pattern, ulong cores, ulong accesses, uint64_t seed, ulong footprint, ulong writePercent);
+   ~SyntheticTraceReader();
+
+   // Parse the part of a spec after GENERATOR_PREFIX, NULL if it is invalid
+   static SyntheticTraceReader *create(const char *spec);
+   ulong nextBatch(const TraceRecord **);
+   ulong getNumCores()     { return numCores; }
+};
+
+#endif
@@ -0,0 +1,107 @@
+/*******************************************************
+                          interval.cc
+********************************************************/
+
+#include <string.h>
+#include "interval.h"
+using namespace std;
+
+// Column names, indexed by CNT_*
+static const char *counterNames[INTERVAL_COUNTERS] = {
+   "reads", "read_misses", "writes", "write_misses", "writebacks", "memory_transactions",
+   "invalidations", "interventions", "flushes", "busrdx", "busupd", "busupgr"
+};
+
+IntervalWriter::IntervalWriter(FILE *f, int fmt, ulong length)
+{
+   fp       = f;
+   format   = fmt;
+   interval = length;
+   closing  = false;
+   if (format == INTERVAL_CSV) {
+      fprintf(fp, "protocol,interval,accesses,core");
+      for (int c = 0; c < INTERVAL_COUNTERS; c++) fprintf(fp, ",%s", counterNames[c]);
+      fprintf(fp, "\n");
+   }
+   writer = thread(&IntervalWriter::drain, this);
+}
+
+IntervalWriter *IntervalWriter::open(const char *fname, ulong length)
+{
+   FILE *f = fopen(fname, "w");
+   if (f == NULL) return NULL;
+   ulong len = strlen(fname);
+   int fmt = (len > 6 && strcmp(fname + len - 6, ".jsonl") == 0) ? INTERVAL_JSONL : INTERVAL_CSV;
+   return new IntervalWriter(f, fmt, length);
+}
+
+void IntervalWriter::submit(IntervalSnapshot *snap)
+{
+   unique_lock<mutex> guard(lock);
+   space.wait(guard, [&]() { return queue.size() < INTERVAL_QUEUE; });
+   queue.push_back(snap);
+   ready.notify_one();
+}
+
+/*writer thread: format the queued snapshots until close()*/
+void IntervalWriter::drain()
+{
+   while (true) {
+      unique_lock<mutex> guard(lock);
+      ready.wait(guard, [&]() { return !queue.empty() || closing; });
+      if (queue.empty()) return;
+      IntervalSnapshot *snap = queue.front();
+      queue.pop_front();
+      guard.unlock();
+      space.notify_one();
+
+      write(snap);
+      delete snap;
+   }
+}
+
+void IntervalWriter::write(IntervalSnapshot *snap)
+{
+   if (snap->run >= previous.size()) {
+      previous.resize(snap->run + 1);
+      numbers.resize(snap->run + 1, 0);
+   }
+   vector<ulong> &prev = previous[snap->run];
+   if (snap->baseline) {
+      prev.swap(snap->counters);
+      return;
+   }
+   if (prev.empty()) prev.assign(snap->counters.size(), 0);
+   ulong number = numbers[snap->run]++;
+
+   ulong cores = snap->counters.size() / INTERVAL_COUNTERS;
+   for (ulong core = 0; core < cores; core++) {
+      const ulong *now  = &snap->counters[core * INTERVAL_COUNTERS];
+      const ulong *last = &prev[core * INTERVAL_COUNTERS];
+      if (format == INTERVAL_CSV) {
+         fprintf(fp, "%s,%lu,%lu,%lu", snap->name, number, snap->accesses, core);
+         for (int c = 0; c < INTERVAL_COUNTERS; c++) fprintf(fp, ",%lu", now[c] - last[c]);
+         fprintf(fp, "\n");
+      }
+      else {
+         fprintf(fp, "{\"protocol\":\"%s\",\"interval\":%lu,\"accesses\":%lu,\"core\":%lu",
+                 snap->name, number, snap->accesses, core);
+         for (int c = 0; c < INTERVAL_COUNTERS; c++) fprintf(fp, ",\"%s\":%lu", counterNames[c], now[c] - last[c]);
+         fprintf(fp, "}\n");
+      }
+   }
+   prev.swap(snap->counters);
+}
+
+void IntervalWriter::close()
+{
+   if (fp == NULL) return;
+   {
+      lock_guard<mutex> guard(lock);
+      closing = true;
+      ready.notify_one();
+   }
+   writer.join();
+   fclose(fp);
+   fp = NULL;
+}
@@ -0,0 +1,78 @@
+/*******************************************************
+                          interval.h
+********************************************************/
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include "cache.h"
+
+// Counters of every core captured in a snapshot: CNT_READ up to CNT_BUSUPGR
+const int INTERVAL_COUNTERS = CNT_BUSUPGR + 1;
+
+// Snapshots that may wait for the writer before submit() blocks
+const ulong INTERVAL_QUEUE = 64;
+
+enum {
+   INTERVAL_CSV = 0,
+   INTERVAL_JSONL
+};
+
+// Raw counters of all cores of one run at the end of an interval
+struct IntervalSnapshot {
+   ulong run;                    // index of the run (protocol) it belongs to
+   const char *name;             // protocol name
+   ulong accesses;               // trace accesses simulated so far
+   bool baseline;                // only the starting point of the next delta, not written
+   std::vector<ulong> counters;  // [core * INTERVAL_COUNTERS + CNT_*]
+};
+
+/*
+Interval statistics. Every --interval accesses a run copies the counters
+of its caches into a snapshot and queues it; a background thread turns the
+snapshots into per-core deltas and formats them, so the simulation loop
+never formats or writes anything. At most INTERVAL_QUEUE snapshots wait
+for the writer; when output falls behind, the simulation blocks instead of
+queueing without bound. Output is one CSV row (or JSON Lines object) per
+core and interval. A run restored from a checkpoint first
+queues a baseline snapshot, so its first interval does not start from zero.
+*/
+class IntervalWriter
+{
+protected:
+   FILE *fp;
+   int format;
+   ulong interval;
+   std::vector< std::vector<ulong> > previous;   // last snapshot of every run
+   std::vector<ulong> numbers;                   // intervals written per run
+
+   std::mutex lock;
+   std::condition_variable ready;     // a snapshot was queued, or closing
+   std::condition_variable space;     // the writer took a snapshot off the queue
+   std::deque<IntervalSnapshot *> queue;
+   bool closing;
+   std::thread writer;
+
+   void drain();
+   void write(IntervalSnapshot *);
+
+public:
+   IntervalWriter(FILE *, int fmt, ulong length);
+   ~IntervalWriter() { close(); }
+
+   // Open fname for writing, the format follows the extension (.jsonl or CSV)
+   static IntervalWriter *open(const char *fname, ulong length);
+   ulong getInterval()  { return interval; }
+   // Queue a snapshot, waiting while the queue is full; the writer takes ownership
+   void submit(IntervalSnapshot *);
+   // Write out everything queued and close the file
+   void close();
+};
+
+#endif
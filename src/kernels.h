@@ -0,0 +1,78 @@
+/*******************************************************
+                          kernels.h
+********************************************************/
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdint.h>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+#include "cache.h"
+
+/*
+Single-pass set scans used by Cache::findLine and Cache::getLRU.
+
+Both work on a whole set stride (a power of two, padded with ways that can
+never win): padding tags are INVALID_TAG and padding stamps UINT16_MAX.
+The vector paths are picked at compile time, with a scalar fallback.
+*/
+
+/*way holding tag, or ways if none; invalid ways hold INVALID_TAG so no
+  separate valid mask is needed*/
+static inline ulong matchTag(const ulong *set, ulong ways, ulong tag)
+{
+#if defined(__AVX2__)
+   if (ways >= 4) {
+      const __m256i key = _mm256_set1_epi64x((long long) tag);
+      for (ulong j = 0; j < ways; j += 4) {
+         __m256i eq = _mm256_cmpeq_epi64(_mm256_load_si256((const __m256i *)(set + j)), key);
+         int mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+         if (mask != 0) return j + __builtin_ctz(mask);
+      }
+      return ways;
+   }
+#elif defined(__SSE4_1__)
+   if (ways >= 2) {
+      const __m128i key = _mm_set1_epi64x((long long) tag);
+      for (ulong j = 0; j < ways; j += 2) {
+         __m128i eq = _mm_cmpeq_epi64(_mm_load_si128((const __m128i *)(set + j)), key);
+         int mask = _mm_movemask_pd(_mm_castsi128_pd(eq));
+         if (mask != 0) return j + __builtin_ctz(mask);
+      }
+      return ways;
+   }
+#endif
+   for (ulong j = 0; j < ways; j++) {
+      if (set[j] == tag) return j;
+   }
+   return ways;
+}
+
+/*first way with the smallest stamp; invalid ways are stamped 0, so this
+  is the first invalid way if there is one and the LRU way otherwise*/
+static inline ulong minStampWay(const uint16_t *seq, ulong ways)
+{
+#if defined(__SSE4_1__)
+   if (ways >= 8) {
+      ulong best = 0, bestSeq = UINT16_MAX + 1;
+      for (ulong j = 0; j < ways; j += 8) {
+         // phminposuw: minimum of 8 stamps in bits 0-15, its lowest index in bits 16-18
+         uint32_t r = (uint32_t) _mm_cvtsi128_si32(_mm_minpos_epu16(_mm_load_si128((const __m128i *)(seq + j))));
+         if ((r & 0xffff) < bestSeq) {
+            bestSeq = r & 0xffff;
+            best    = j + (r >> 16);
+         }
+      }
+      return best;
+   }
+#endif
+   ulong best = 0;
+   for (ulong j = 1; j < ways; j++) {
+      if (seq[j] < seq[best]) best = j;
+   }
+   return best;
+}
+
+#endif
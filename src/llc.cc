@@ -0,0 +1,184 @@
+/*******************************************************
+                          llc.cc
+********************************************************/
+
+#include <string.h>
+#include "llc.h"
+
+int parseLLCMode(const char *name)
+{
+   if (strcmp(name, "inclusive") == 0)     return LLC_INCLUSIVE;
+   if (strcmp(name, "non-inclusive") == 0) return LLC_NON_INCLUSIVE;
+   if (strcmp(name, "exclusive") == 0)     return LLC_EXCLUSIVE;
+   return -1;
+}
+
+const char *llcModeName(int mode)
+{
+   switch (mode) {
+      case LLC_INCLUSIVE:     return "inclusive";
+      case LLC_NON_INCLUSIVE: return "non-inclusive";
+      case LLC_EXCLUSIVE:     return "exclusive";
+      default:                return "unknown";
+   }
+}
+
+LastLevelCache::LastLevelCache(int s, int a, int b, int llcMode, ulong procs, int policy)
+   : Cache(s, a, b, 0, policy)
+{
+   mode     = llcMode;
+   numProcs = procs;
+   ulong **perCore[] = {&reads, &readHits, &writes, &dramReads, &dramWrites, &backInvalidations};
+   for (int c = 0; c < 6; c++) {
+      *perCore[c] = new ulong[numProcs];
+      memset(*perCore[c], 0, numProcs * sizeof(ulong));
+   }
+}
+
+LastLevelCache::~LastLevelCache()
+{
+   delete [] reads;
+   delete [] readHits;
+   delete [] writes;
+   delete [] dramReads;
+   delete [] dramWrites;
+   delete [] backInvalidations;
+}
+
+ulong LastLevelCache::allocate(ulong proc, ulong addr, bool dirty)
+{
+   currentCycle++;
+   lineId victim = findLineToReplace(addr);
+   ulong backInvalidate = NO_VICTIM;
+   if (isValid(victim)) {
+      if (getFlags(victim) == DIRTY) dramWrites[proc]++;
+      if (mode == LLC_INCLUSIVE) backInvalidate = calcAddr4Tag(getTag(victim));
+   }
+   installLine(victim, addr);
+   if (dirty) setFlags(victim, DIRTY);
+   return backInvalidate;
+}
+
+void LastLevelCache::touch(lineId line, bool dirty)
+{
+   currentCycle++;
+   updateLRU(line);
+   if (dirty) setFlags(line, DIRTY);
+}
+
+ulong LastLevelCache::read(ulong proc, ulong addr)
+{
+   reads[proc]++;
+   lineId line = findLine(addr);
+   if (line != NO_LINE) {
+      readHits[proc]++;
+      if (mode == LLC_EXCLUSIVE) {
+         if (getFlags(line) == DIRTY) dramWrites[proc]++;
+         invalidate(line);
+      }
+      else {
+         touch(line, false);
+      }
+      return NO_VICTIM;
+   }
+   dramReads[proc]++;
+   if (mode == LLC_EXCLUSIVE) return NO_VICTIM;
+   return allocate(proc, addr, false);
+}
+
+ulong LastLevelCache::writeBack(ulong proc, ulong addr)
+{
+   writes[proc]++;
+   lineId line = findLine(addr);
+   if (line != NO_LINE) {
+      touch(line, true);
+      return NO_VICTIM;
+   }
+   // the block lives in the L1s only: straight to DRAM
+   if (mode == LLC_EXCLUSIVE) {
+      dramWrites[proc]++;
+      return NO_VICTIM;
+   }
+   return allocate(proc, addr, true);
+}
+
+ulong LastLevelCache::evict(ulong proc, ulong addr, bool dirty)
+{
+   if (mode != LLC_EXCLUSIVE) {
+      return dirty ? writeBack(proc, addr) : NO_VICTIM;
+   }
+   // exclusive: the LLC is a victim cache of the L1s
+   if (dirty) writes[proc]++;
+   lineId line = findLine(addr);
+   if (line != NO_LINE) {
+      touch(line, dirty);
+      return NO_VICTIM;
+   }
+   return allocate(proc, addr, dirty);
+}
+
+void LastLevelCache::mergeStats(LastLevelCache *other)
+{
+   for (ulong i = 0; i < numProcs; i++) {
+      reads[i]             += other->reads[i];
+      readHits[i]          += other->readHits[i];
+      writes[i]            += other->writes[i];
+      dramReads[i]         += other->dramReads[i];
+      dramWrites[i]        += other->dramWrites[i];
+      backInvalidations[i] += other->backInvalidations[i];
+   }
+}
+
+void LastLevelCache::clearCounters()
+{
+   Cache::clearCounters();
+   ulong *perCore[] = {reads, readHits, writes, dramReads, dramWrites, backInvalidations};
+   for (int c = 0; c < 6; c++) memset(perCore[c], 0, numProcs * sizeof(ulong));
+}
+
+void LastLevelCache::reset()
+{
+   resetState(0);
+   clearCounters();
+}
+
+bool LastLevelCache::saveState(FILE *fp)
+{
+   if (!Cache::saveState(fp)) return false;
+   ulong *perCore[] = {reads, readHits, writes, dramReads, dramWrites, backInvalidations};
+   for (int c = 0; c < 6; c++) {
+      if (fwrite(perCore[c], sizeof(ulong), numProcs, fp) != numProcs) return false;
+   }
+   return true;
+}
+
+bool LastLevelCache::loadState(FILE *fp, int savedPolicy)
+{
+   if (!Cache::loadState(fp, savedPolicy)) return false;
+   ulong *perCore[] = {reads, readHits, writes, dramReads, dramWrites, backInvalidations};
+   for (int c = 0; c < 6; c++) {
+      if (fread(perCore[c], sizeof(ulong), numProcs, fp) != numProcs) return false;
+   }
+   return true;
+}
+
+void LastLevelCache::printStats()
+{
+   ulong totalReads = 0, totalHits = 0, totalDram = 0;
+   for (ulong i = 0; i < numProcs; i++) {
+      printf("============ Shared LLC results (Core %lu) ============\n", i);
+      printf("01. number of LLC reads:                        %lu\n", reads[i]);
+      printf("02. number of LLC read hits:                    %lu\n", readHits[i]);
+      printf("03. LLC hit rate:                               %.2f%%\n", reads[i] ? 100.0 * readHits[i] / reads[i] : 0.0);
+      printf("04. number of LLC writebacks:                   %lu\n", writes[i]);
+      printf("05. number of DRAM reads:                       %lu\n", dramReads[i]);
+      printf("06. number of DRAM writes:                      %lu\n", dramWrites[i]);
+      printf("07. number of back-invalidations:               %lu\n", backInvalidations[i]);
+      totalReads += reads[i];
+      totalHits  += readHits[i];
+      totalDram  += dramReads[i] + dramWrites[i];
+   }
+   printf("============ Shared LLC totals ============\n");
+   printf("LLC hit rate:                                   %.2f%%\n", totalReads ? 100.0 * totalHits / totalReads : 0.0);
+   printf("DRAM transactions:                              %lu\n", totalDram);
+}
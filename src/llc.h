@@ -0,0 +1,73 @@
+/*******************************************************
+                          llc.h
+********************************************************/
+
+#ifndef LLC_H
+#define LLC_H
+
+#include <stdio.h>
+#include "cache.h"
+
+/****LLC inclusion policies****/
+enum {
+   LLC_INCLUSIVE = 0,   // every L1 block is in the LLC; LLC evictions back-invalidate the L1s
+   LLC_NON_INCLUSIVE,   // fills allocate in the LLC, evictions leave the L1s alone
+   LLC_EXCLUSIVE        // L1 victims are inserted, hits move the block up to the L1
+};
+int parseLLCMode(const char *);
+const char *llcModeName(int);
+
+// returned when no block has to be back-invalidated from the L1s
+const ulong NO_VICTIM = ~0UL;
+
+/*
+Shared last-level cache below the private L1s, built on the same set/way
+arrays. It sees the L1 fills that are not supplied by another L1, the L1
+victims, the flushes that update memory and write-through updates, and
+counts what it has to read from or write to DRAM on behalf of each core.
+Coherence stays in the L1s; the LLC only tracks clean/dirty.
+
+The L1s keep their own protocol state, so a dirty block that leaves the LLC
+for an L1 (exclusive hit) is written back to DRAM.
+*/
+class LastLevelCache : public Cache
+{
+protected:
+   int mode;
+   ulong numProcs;
+   // per core counters
+   ulong *reads, *readHits, *writes, *dramReads, *dramWrites, *backInvalidations;
+
+   // put the block of addr into a victim way, returns the victim to back-invalidate
+   ulong allocate(ulong proc, ulong addr, bool dirty);
+   // hit: optionally mark dirty and refresh the replacement state
+   void touch(lineId line, bool dirty);
+
+public:
+   LastLevelCache(int s, int a, int b, int llcMode, ulong procs, int policy = REPL_LRU);
+   ~LastLevelCache();
+
+   // An L1 of proc misses on addr and no other L1 supplies the block
+   ulong read(ulong proc, ulong addr);
+   // Data of addr is written to memory on behalf of proc: a snooping L1's
+   // flush, or a write-through by proc itself
+   ulong writeBack(ulong proc, ulong addr);
+   // The L1 of proc evicted the block of addr
+   ulong evict(ulong proc, ulong addr, bool dirty);
+   // An L1 copy was removed on behalf of proc after an inclusive LLC eviction
+   void backInvalidated(ulong proc, bool dirty)   { backInvalidations[proc]++; if (dirty) dramWrites[proc]++; }
+
+   int getMode()                 { return mode; }
+
+   // Accumulate the counters of another LLC (used to merge set shards)
+   void mergeStats(LastLevelCache *);
+   void clearCounters();
+   // Empty the LLC and zero all counters in place
+   void reset();
+   // Checkpoints: the Cache state followed by the per core counters
+   bool saveState(FILE *);
+   bool loadState(FILE *, int savedPolicy);
+   void printStats();
+};
+
+#endif
@@ -4,10 +4,28 @@
 
 #include <stdlib.h>
 #include <assert.h>
-#include <fstream>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string>
 using namespace std;
 
 #include "cache.h"
+#include "trace.h"
+#include "protocol.h"
+#include "system.h"
+#include "sweep.h"
+#include "interval.h"
+#include "generate.h"
+#include "checkpoint.h"
+#include "sampling.h"
+#include "validate.h"
+
+// Number of accesses buffered before the set shards are simulated
+const ulong SHARD_CHUNK = 1 << 20;
+
 void printPersonalInfo()
 {
     printf("===== 506 Personal information =====\n");
@@ -15,16 +33,570 @@ void printPersonalInfo()
     printf("unity\n");
     printf("ECE406 Students? NO\n");
 }
+
+// Worker threads of a set-sharded run, one per shard, kept alive across
+// chunks. Coherence and LRU state never cross a set boundary, so every
+// shard sees exactly the per-set access order of a serial run.
+template <class P>
+class ShardWorkers
+{
+protected:
+    vector<CacheSystem<P> *> &shardSystems;
+    vector< vector<TraceRecord> > &shards;
+    vector<thread> workers;
+    mutex lock;
+    condition_variable start, done;
+    ulong generation, busy;
+    bool stopping;
+
+    void work(ulong t)
+    {
+        ulong seen = 0;
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            start.wait(guard, [&]() { return generation != seen || stopping; });
+            if (generation == seen) return;
+            seen = generation;
+            guard.unlock();
+            for (const TraceRecord &rec : shards[t]) {
+                simulateAccess(shardSystems[t], rec.getProc(), rec.getOp(), rec.getAddr());
+            }
+            shards[t].clear();
+            guard.lock();
+            if (--busy == 0) done.notify_one();
+        }
+    }
+
+public:
+    ShardWorkers(vector<CacheSystem<P> *> &systems, vector< vector<TraceRecord> > &chunks)
+        : shardSystems(systems), shards(chunks), generation(0), busy(0), stopping(false)
+    {
+        for (ulong t = 0; t < shards.size(); t++) workers.push_back(thread(&ShardWorkers::work, this, t));
+    }
+    ~ShardWorkers()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        start.notify_all();
+        for (ulong t = 0; t < workers.size(); t++) workers[t].join();
+    }
+
+    // Simulate the buffered chunk of every shard and wait for all of them
+    void run()
+    {
+        unique_lock<mutex> guard(lock);
+        busy = shards.size();
+        generation++;
+        start.notify_all();
+        done.wait(guard, [&]() { return busy == 0; });
+    }
+};
+
+// One simulated system consuming the trace batch by batch
+class SimulationRun
+{
+public:
+    virtual ~SimulationRun() {}
+    virtual void simulate(const TraceRecord *batch, ulong n) = 0;
+    // Simulate any buffered accesses and print the statistics of all caches
+    virtual void finish() = 0;
+    virtual const char *getName() = 0;
+    // Queue a snapshot of the counters every writer->getInterval() accesses
+    virtual void recordIntervals(IntervalWriter *writer, ulong run) = 0;
+    // Save the cache state to fname once access number access is reached
+    virtual void checkpointAt(ulong access, const string &fname) = 0;
+    // Start from a checkpoint, *offset is the number of trace accesses it covers
+    virtual bool restore(const char *fname, ulong *offset) = 0;
+};
+
+// All caches running protocol P, optionally set-sharded over several threads
+template <class P>
+class ProtocolRun : public SimulationRun
+{
+protected:
+    CacheSystem<P> *sys;
+    ulong num_threads, pending;
+    SimConfig config;
+    IntervalWriter *intervals;
+    ulong runId, accesses, nextSnapshot;
+    ulong saveAt;           // 0: no checkpoint to save
+    string saveFile;
+    // sampling: the window currently simulated in detail ends at sampleEdge,
+    // or the next one starts there
+    SampledStats *sampled;
+    ulong sampleEdge;
+    bool inWindow;
+    vector<ulong> windowStart;
+    // each shard owns a private copy of every cache but only ever touches
+    // the sets assigned to it, so counters can be summed at the end
+    vector<CacheSystem<P> *> shardSystems;
+    vector< vector<TraceRecord> > shards;
+    ShardWorkers<P> *workers;
+
+public:
+    ProtocolRun(const SimConfig &cfg, ulong threads)
+    {
+        // Create the caches of all processors
+        config = cfg;
+        sys = createSystem<P>(cfg);
+        // a shard is a set of cache sets, so there is no point in more threads than sets;
+        // the bus timing, the fully associative shadow caches, the event log
+        // and a checkpoint span all sets, so they need the serial order,
+        // and so do sampling windows
+        num_threads = (cfg.timing || cfg.classifyMisses || cfg.events != NULL || cfg.checkpoint || cfg.samplePeriod != 0) ? 1 : threads;
+        // an LLC set must not span shards: its sets have to be indexed by at least the L1 set bits
+        if (sys->llc != NULL && sys->llc->getNumSets() < sys->caches[0]->getNumSets()) num_threads = 1;
+        if (num_threads < 1) num_threads = 1;
+        if (num_threads > sys->caches[0]->getNumSets()) num_threads = sys->caches[0]->getNumSets();
+        pending = 0;
+        intervals    = NULL;
+        runId        = 0;
+        accesses     = 0;
+        nextSnapshot = 0;
+        saveAt       = 0;
+        sampled      = NULL;
+        workers      = NULL;
+        inWindow     = false;
+        if (cfg.samplePeriod != 0) {
+            sampled    = new SampledStats(cfg.numProcs, cfg.sampleWindow, cfg.timing);
+            sampleEdge = cfg.samplePeriod - cfg.sampleWindow;
+        }
+        if (num_threads > 1) {
+            shardSystems.resize(num_threads);
+            shards.resize(num_threads);
+            for (ulong t = 0; t < num_threads; t++) {
+                shardSystems[t] = createSystem<P>(cfg);
+                shards[t].reserve(SHARD_CHUNK / num_threads + 1);
+            }
+            workers = new ShardWorkers<P>(shardSystems, shards);
+        }
+    }
+
+    const char *getName() { return P::name(); }
+
+    void recordIntervals(IntervalWriter *writer, ulong run)
+    {
+        intervals    = writer;
+        runId        = run;
+        // restored counters are the baseline of the first interval
+        if (accesses != 0) snapshot(true);
+        nextSnapshot = accesses + writer->getInterval();
+    }
+
+    void checkpointAt(ulong access, const string &fname)
+    {
+        saveAt   = access;
+        saveFile = fname;
+    }
+
+    // Every shard gets the whole state but only uses its own sets; the
+    // counters stay in sys, which the shards are merged into at the end
+    bool restore(const char *fname, ulong *offset)
+    {
+        if (!loadCheckpoint(sys, config, fname, offset)) return false;
+        for (ulong t = 0; t < shardSystems.size(); t++) {
+            if (!loadCheckpoint(shardSystems[t], config, fname, offset)) return false;
+            for (ulong i = 0; i < sys->numProcs; i++) shardSystems[t]->caches[i]->clearCounters();
+            if (sys->llc != NULL) shardSystems[t]->llc->clearCounters();
+        }
+        accesses   = *offset;
+        if (sys->events != NULL) sys->events->seek(accesses);
+        sampleEdge = accesses + config.samplePeriod - config.sampleWindow;
+        return true;
+    }
+
+    // Access count of the next interval boundary or checkpoint, ~0 if none
+    ulong nextStop()
+    {
+        ulong stop = ~0UL;
+        if (intervals != NULL) stop = nextSnapshot;
+        if (saveAt > accesses && saveAt < stop) stop = saveAt;
+        if (sampled != NULL && sampleEdge < stop) stop = sampleEdge;
+        return stop;
+    }
+
+    // Start or end a sampling window: windowStart holds the counters at its start
+    void sampleBoundary()
+    {
+        vector<ulong> now(sys->numProcs * SAMPLED_VALUES, 0);
+        for (ulong i = 0; i < sys->numProcs; i++) {
+            ulong *values = &now[i * SAMPLED_VALUES];
+            for (int c = 0; c < SAMPLED_COUNTERS; c++) values[c] = sys->caches[i]->getCounter(c);
+            if (sys->timer != NULL) {
+                values[SAMPLE_CYCLES]      = sys->timer->getCycles(i);
+                values[SAMPLE_WAIT_CYCLES] = sys->timer->getWaitCycles(i);
+            }
+        }
+        if (inWindow) {
+            for (ulong k = 0; k < now.size(); k++) now[k] -= windowStart[k];
+            sampled->addWindow(now);
+            sampleEdge = accesses + config.samplePeriod - config.sampleWindow;
+        }
+        else {
+            windowStart.swap(now);
+            sampleEdge = accesses + config.sampleWindow;
+        }
+        inWindow = !inWindow;
+    }
+
+    void reachedStop()
+    {
+        if (intervals != NULL && accesses == nextSnapshot) snapshot();
+        if (sampled != NULL && accesses == sampleEdge) sampleBoundary();
+        if (accesses == saveAt && !saveCheckpoint(sys, config, accesses, saveFile.c_str())) {
+            printf("Cannot write checkpoint %s\n", saveFile.c_str());
+        }
+    }
+
+    // Copy the counters of all caches for the writer thread. Shards are
+    // only merged at the end, so a sharded run sums them on the fly.
+    void snapshot(bool baseline = false)
+    {
+        IntervalSnapshot *snap = new IntervalSnapshot;
+        snap->run      = runId;
+        snap->name     = P::name();
+        snap->accesses = accesses;
+        snap->baseline = baseline;
+        snap->counters.assign(sys->numProcs * INTERVAL_COUNTERS, 0);
+        for (ulong i = 0; i < sys->numProcs; i++) {
+            ulong *counters = &snap->counters[i * INTERVAL_COUNTERS];
+            for (int c = 0; c < INTERVAL_COUNTERS; c++) {
+                counters[c] = sys->caches[i]->getCounter(c);
+                for (ulong t = 0; t < shardSystems.size(); t++) counters[c] += shardSystems[t]->caches[i]->getCounter(c);
+            }
+        }
+        intervals->submit(snap);
+        nextSnapshot = accesses + intervals->getInterval();
+    }
+
+    void simulate(const TraceRecord *batch, ulong n)
+    {
+        ulong stop = nextStop();
+        if (num_threads > 1) {
+            for (ulong i = 0; i < n; i++) {
+                shards[sys->caches[0]->getSetIndex(batch[i].getAddr()) % num_threads].push_back(batch[i]);
+                pending++;
+                accesses++;
+                // an interval boundary also ends the chunk
+                if (pending >= SHARD_CHUNK || accesses == stop) {
+                    workers->run();
+                    pending = 0;
+                    if (accesses == stop) {
+                        reachedStop();
+                        stop = nextStop();
+                    }
+                }
+            }
+            return;
+        }
+        for (ulong i = 0; i < n; ) {
+            // simulate up to the next interval boundary or checkpoint
+            ulong end = n;
+            if (stop - accesses < n - i) end = i + (stop - accesses);
+            accesses += end - i;
+            if (sampled != NULL && !inWindow) {
+                for (; i < end; i++) warmAccess(sys, batch[i].getProc(), batch[i].getOp(), batch[i].getAddr());
+            }
+            for (; i < end; i++) {
+                simulateAccess(sys, batch[i].getProc(), batch[i].getOp(), batch[i].getAddr());
+            }
+            if (accesses == stop) {
+                reachedStop();
+                stop = nextStop();
+            }
+        }
+    }
+
+    void finish()
+    {
+        if (num_threads > 1) {
+            workers->run();
+            delete workers;
+            workers = NULL;
+        }
+        // the last, partial interval
+        if (intervals != NULL && accesses + intervals->getInterval() > nextSnapshot) snapshot();
+        if (num_threads > 1) {
+            for (ulong t = 0; t < num_threads; t++) {
+                for (ulong i = 0; i < sys->numProcs; i++) {
+                    sys->caches[i]->mergeStats(shardSystems[t]->caches[i]);
+                }
+                if (sys->llc != NULL) sys->llc->mergeStats(shardSystems[t]->llc);
+                if (sys->sharing != NULL) sys->sharing->mergeStats(shardSystems[t]->sharing);
+            }
+        }
+
+        // sampling: only the windows were counted, report the estimates
+        if (sampled != NULL && sampled->getWindows() > 0) {
+            for (ulong i = 0; i < sys->numProcs; i++) sampled->printStats(i, accesses, P::updateBased, P::upgrades);
+            sampled->printSummary(accesses, config.samplePeriod);
+            return;
+        }
+        // no window completed, so there is nothing to estimate from: report
+        // the detailed part of the unfinished window (warming evictions also
+        // count writebacks, so the counters start from the window's start)
+        if (sampled != NULL) {
+            ulong detailed = inWindow ? accesses - (sampleEdge - config.sampleWindow) : 0;
+            for (ulong i = 0; i < sys->numProcs; i++) {
+                for (int c = 0; c < SAMPLED_COUNTERS; c++) {
+                    ulong base = inWindow ? windowStart[i * SAMPLED_VALUES + c] : sys->caches[i]->getCounter(c);
+                    sys->caches[i]->setCounter(c, sys->caches[i]->getCounter(c) - base);
+                }
+            }
+            printf("Warning: no sampling window completed in %lu accesses (period %lu), the statistics below only count the %lu accesses simulated in detail\n",
+                   accesses, config.samplePeriod, detailed);
+        }
+
+        //********************************//
+        //print out all caches' statistics //
+        //********************************//
+        for (ulong i=0; i < sys->numProcs; i++) {
+            int next = sys->caches[i]->printStats(i);
+            if (sys->timer != NULL) sys->timer->printCoreStats(i, next);
+        }
+        if (sys->timer != NULL) sys->timer->printBusStats();
+        if (sys->llc != NULL) sys->llc->printStats();
+        if (sys->sharing != NULL) sys->sharing->printStats();
+    }
+};
+
+// Output file of one run: with several protocols each one gets <base>.<protocol>
+string runFileName(const char *base, ulong protocol, ulong numRuns)
+{
+    string name = base;
+    if (numRuns > 1) name = name + "." + protocolName(protocol);
+    return name;
+}
+
+// Pick the protocol once; everything below is specialized for it
+SimulationRun *createRun(const SimConfig &cfg, ulong num_threads)
+{
+    switch (cfg.protocol) {
+        case PROTO_MSI:     return new ProtocolRun<MSIProtocol>(cfg, num_threads);
+        case PROTO_DRAGON:  return new ProtocolRun<DragonProtocol>(cfg, num_threads);
+        case PROTO_MESI:    return new ProtocolRun<MESIProtocol>(cfg, num_threads);
+        case PROTO_MOESI:   return new ProtocolRun<MOESIProtocol>(cfg, num_threads);
+        case PROTO_FIREFLY: return new ProtocolRun<FireflyProtocol>(cfg, num_threads);
+        default:            return NULL;
+    }
+}
+
+// Feed every decoded batch to all runs. With several runs each one gets its
+// own thread; they all read the same batch while this thread already fetches
+// the next one, so decoding overlaps with simulation. A source whose batches
+// are reused on the next call is copied into two alternating buffers.
+void runSimulation(vector<SimulationRun *> &runs, TraceReader *trace)
+{
+    const TraceRecord *batch; // Decoded accesses, each one processor, operation (r, w) and address
+    ulong n;
+
+    if (runs.size() == 1) {
+        while((n = trace->nextBatch(&batch)) > 0) runs[0]->simulate(batch, n);
+    }
+    else {
+        mutex lock;
+        condition_variable wake, done;
+        ulong generation = 0, busy = 0;
+        bool finished = false;
+
+        vector<thread> workers;
+        for (ulong r = 0; r < runs.size(); r++) {
+            workers.push_back(thread([&, r]() {
+                ulong seen = 0;
+                while (true) {
+                    unique_lock<mutex> guard(lock);
+                    wake.wait(guard, [&]() { return generation != seen || finished; });
+                    if (generation == seen) return;
+                    seen = generation;
+                    guard.unlock();
+
+                    runs[r]->simulate(batch, n);
+
+                    guard.lock();
+                    if (--busy == 0) done.notify_one();
+                }
+            }));
+        }
+
+        TraceRecord *buffers[2] = {NULL, NULL};
+        if (!trace->stableBatches()) {
+            buffers[0] = new TraceRecord[TRACE_BATCH];
+            buffers[1] = new TraceRecord[TRACE_BATCH];
+        }
+        const TraceRecord *next;
+        ulong got = trace->nextBatch(&next);
+        for (ulong b = 0; got > 0; b++) {
+            if (buffers[0] != NULL) {
+                memcpy(buffers[b % 2], next, got * sizeof(TraceRecord));
+                next = buffers[b % 2];
+            }
+            unique_lock<mutex> guard(lock);
+            batch = next;
+            n     = got;
+            busy  = runs.size();
+            generation++;
+            wake.notify_all();
+            guard.unlock();
+
+            got = trace->nextBatch(&next);
+
+            guard.lock();
+            done.wait(guard, [&]() { return busy == 0; });
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            finished = true;
+            wake.notify_all();
+        }
+        for (ulong r = 0; r < workers.size(); r++) workers[r].join();
+        delete [] buffers[0];
+        delete [] buffers[1];
+    }
+    delete trace;
+
+    for (ulong r = 0; r < runs.size(); r++) {
+        if (runs.size() > 1) printf("===== %s =====\n", runs[r]->getName());
+        runs[r]->finish();
+    }
+}
+
+// ./smp_cache sweep <num_processors> <trace_file> [--sizes list] [--assocs list] [--blocks list] [--invalidate]
+// Print a CSV of miss counts for every cache geometry of the grid, from one trace pass
+int runSweep(int argc, char *argv[])
+{
+    vector<ulong> sizes, assocs, blocks;
+    parseSizeList("1024,2048,4096,8192,16384,32768,65536,131072,262144", sizes);
+    parseSizeList("1,2,4,8,16", assocs);
+    parseSizeList("16,32,64,128", blocks);
+    bool invalidate = false;
+
+    ulong num_processors = atoi(argv[2]);
+    const char *fname    = argv[3];
+    for (int a = 4; a < argc; a++) {
+        bool ok = true;
+        if      (strcmp(argv[a], "--sizes") == 0 && a + 1 < argc)  ok = parseSizeList(argv[++a], sizes);
+        else if (strcmp(argv[a], "--assocs") == 0 && a + 1 < argc) ok = parseSizeList(argv[++a], assocs);
+        else if (strcmp(argv[a], "--blocks") == 0 && a + 1 < argc) ok = parseSizeList(argv[++a], blocks);
+        else if (strcmp(argv[a], "--invalidate") == 0)             invalidate = true;
+        else {
+            fprintf(stderr, "unknown option: %s\n", argv[a]);
+            return 1;
+        }
+        if (!ok) {
+            fprintf(stderr, "bad list: %s\n", argv[a]);
+            return 1;
+        }
+    }
+    if (num_processors == 0 || num_processors > MAX_TRACE_CORES) {
+        fprintf(stderr, "Number of processors must be between 1 and %lu\n", MAX_TRACE_CORES);
+        return 1;
+    }
+
+    TraceReader *trace = TraceReader::open(fname);
+    if (trace == NULL) {
+        fprintf(stderr, "Trace file problem\n");
+        return 1;
+    }
+    if (trace->getNumCores() > num_processors) {
+        fprintf(stderr, "Trace file has %lu cores, but only %lu processors are simulated\n", trace->getNumCores(), num_processors);
+        return 1;
+    }
+    trace->limitCores(num_processors);
+    trace = new PipelinedTraceReader(trace);
+
+    StackDistanceSweep sweep(num_processors, sizes, assocs, blocks, invalidate);
+    if (sweep.getNumConfigs() == 0) {
+        fprintf(stderr, "No valid cache geometry in the sweep grid\n");
+        return 1;
+    }
+    const TraceRecord *batch;
+    ulong n;
+    while ((n = trace->nextBatch(&batch)) > 0) {
+        for (ulong i = 0; i < n; i++) sweep.access(batch[i].getProc(), batch[i].getOp(), batch[i].getAddr());
+    }
+    delete trace;
+
+    sweep.printCSV(stdout);
+    return 0;
+}
+
+// ./smp_cache validate [--jobs N] [--traces dir] [reference file or directory...]
+// Rerun every reference output in-process and compare its statistics
+int runValidate(int argc, char *argv[])
+{
+    vector<string> paths;
+    const char *trace_dir = "../trace";
+    ulong jobs = thread::hardware_concurrency();
+    for (int a = 2; a < argc; a++) {
+        if      (strcmp(argv[a], "--jobs") == 0 && a + 1 < argc)   jobs = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--traces") == 0 && a + 1 < argc) trace_dir = argv[++a];
+        else if (argv[a][0] == '-') {
+            fprintf(stderr, "unknown option: %s\n", argv[a]);
+            return 1;
+        }
+        else paths.push_back(argv[a]);
+    }
+    // val.v2/ revises the original val/ outputs, so it comes first
+    if (paths.empty()) {
+        paths.push_back("../val.v2");
+        paths.push_back("../val");
+    }
+    if (jobs < 1) jobs = 1;
+    int failed = validateAll(paths, trace_dir, jobs, stdout);
+    return failed == 0 ? 0 : 1;
+}
+
 int main(int argc, char *argv[])
 {
+    // ./smp_cache convert <text_trace> <binary_trace>
+    if (argc == 4 && strcmp(argv[1], "convert") == 0) {
+        long count = convertTrace(argv[2], argv[3]);
+        if (count < 0) {
+            printf("Trace conversion problem\n");
+            exit(1);
+        }
+        printf("Converted %ld accesses from %s to %s\n", count, argv[2], argv[3]);
+        return 0;
+    }
+    // ./smp_cache generate <pattern,cores,accesses[,options]> <binary_trace>
+    if (argc == 4 && strcmp(argv[1], "generate") == 0) {
+        string spec = string(GENERATOR_PREFIX) + argv[2];
+        long count = convertTrace(spec.c_str(), argv[3]);
+        if (count < 0) {
+            printf("Trace generation problem\n");
+            exit(1);
+        }
+        printf("Generated %ld accesses into %s\n", count, argv[3]);
+        return 0;
+    }
+    // ./smp_cache events <event_log>
+    if (argc == 3 && strcmp(argv[1], "events") == 0) {
+        if (!decodeEvents(argv[2], stdout)) {
+            fprintf(stderr, "Event log problem\n");
+            return 1;
+        }
+        return 0;
+    }
+    if (argc >= 4 && strcmp(argv[1], "sweep") == 0) {
+        return runSweep(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "validate") == 0) {
+        return runValidate(argc, argv);
+    }
+
     // print personal info as required
     printPersonalInfo();
-    ifstream fin;
-    FILE * pFile;
 
     if(argv[1] == NULL){
          printf("input format: ");
-         printf("./smp_cache <cache_size> <assoc> <block_size> <num_processors> <protocol> <trace_file> \n");
+         printf("./smp_cache <cache_size> <assoc> <block_size> <num_processors> <protocol[,protocol...]> <trace_file> [--threads N] [--snoop-filter] [--replacement lru|tree-plru|bit-plru|srrip] [--no-pipeline] [--timing] [--latency hit,memory,flush,update,bus] [--llc size,assoc] [--llc-mode inclusive|non-inclusive|exclusive] [--cluster-size K] [--classify-misses] [--false-sharing] [--interval N] [--interval-out file] [--events file] [--event-cores list] [--event-addrs low-high] [--event-accesses first-last] [--checkpoint-at K] [--checkpoint-out file] [--restore file] [--sample period,window]\n");
+         printf("       ./smp_cache convert <text_trace> <binary_trace>\n");
+         printf("       ./smp_cache generate <random|migratory|prodcons|readmostly|falsesharing>,<cores>,<accesses>[,seed=S][,footprint=BYTES][,writes=PCT] <binary_trace>\n");
+         printf("       ./smp_cache events <event_log>\n");
+         printf("       ./smp_cache sweep <num_processors> <trace_file> [--sizes list] [--assocs list] [--blocks list] [--invalidate]\n");
+         printf("       ./smp_cache validate [--jobs N] [--traces dir] [reference file or directory...]\n");
          exit(0);
         }
 
@@ -32,9 +604,157 @@ int main(int argc, char *argv[])
     ulong cache_assoc    = atoi(argv[2]);
     ulong blk_size       = atoi(argv[3]);
     ulong num_processors = atoi(argv[4]);
-    ulong protocol       = atoi(argv[5]); /* 0:MODIFIED_MSI 1:DRAGON*/
+    vector<ulong> protocols;             /* 0:MODIFIED_MSI 1:DRAGON 2:MESI 3:MOESI 4:FIREFLY, comma separated*/
+    for (char *p = argv[5]; ; p++) {
+        protocols.push_back(strtoul(p, &p, 10));
+        if (*p != ',') break;
+    }
     char *fname        = (char *) malloc(20);
     fname              = argv[6]; // trace_file
+    ulong num_threads    = 1;
+    bool snoop_filter    = false;
+    bool pipeline        = true;
+    bool timing          = false;
+    BusLatencies latency = defaultLatencies();
+    ulong llc_size       = 0;
+    ulong llc_assoc      = 0;
+    int llc_mode         = LLC_INCLUSIVE;
+    ulong cluster_size   = 0;
+    bool classify_misses = false;
+    bool false_sharing   = false;
+    ulong interval       = 0;
+    const char *interval_out = "intervals.csv";
+    const char *event_file   = NULL;
+    EventFilter event_filter;
+    ulong checkpoint_at      = 0;
+    const char *checkpoint_out = "checkpoint.smp";
+    const char *restore_file = NULL;
+    ulong trace_offset       = 0;
+    ulong sample_period      = 0;
+    ulong sample_window      = 0;
+    int replacement      = REPL_LRU;
+
+    // optional arguments following the trace file
+    for (int a = 7; a < argc; a++) {
+        if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+            char *end;
+            long n = strtol(argv[++a], &end, 10);
+            if (end == argv[a] || *end != '\0' || n < 1) {
+                printf("bad thread count: %s (expected a number of at least 1)\n", argv[a]);
+                exit(0);
+            }
+            num_threads = n;
+        }
+        else if (strcmp(argv[a], "--snoop-filter") == 0) {
+            snoop_filter = true;
+        }
+        else if (strcmp(argv[a], "--timing") == 0) {
+            timing = true;
+        }
+        else if (strcmp(argv[a], "--latency") == 0 && a + 1 < argc) {
+            timing = true;
+            if (!parseLatencies(argv[++a], latency)) {
+                printf("bad latency list: %s (expected hit,memory,flush,update,bus)\n", argv[a]);
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[a], "--llc") == 0 && a + 1 < argc) {
+            vector<ulong> geometry;
+            if (!parseSizeList(argv[++a], geometry) || geometry.size() != 2) {
+                printf("bad LLC geometry: %s (expected size,assoc)\n", argv[a]);
+                exit(0);
+            }
+            llc_size  = geometry[0];
+            llc_assoc = geometry[1];
+        }
+        else if (strcmp(argv[a], "--llc-mode") == 0 && a + 1 < argc) {
+            llc_mode = parseLLCMode(argv[++a]);
+            if (llc_mode < 0) {
+                printf("unknown LLC mode: %s\n", argv[a]);
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[a], "--cluster-size") == 0 && a + 1 < argc) {
+            cluster_size = atoi(argv[++a]);
+            if (cluster_size == 0) {
+                printf("cluster size must be at least 1\n");
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[a], "--classify-misses") == 0) {
+            classify_misses = true;
+        }
+        else if (strcmp(argv[a], "--false-sharing") == 0) {
+            false_sharing = true;
+        }
+        else if (strcmp(argv[a], "--interval") == 0 && a + 1 < argc) {
+            interval = strtoul(argv[++a], NULL, 10);
+            if (interval == 0) {
+                printf("interval must be at least 1 access\n");
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[a], "--interval-out") == 0 && a + 1 < argc) {
+            interval_out = argv[++a];
+        }
+        else if (strcmp(argv[a], "--events") == 0 && a + 1 < argc) {
+            event_file = argv[++a];
+        }
+        else if (strcmp(argv[a], "--event-cores") == 0 && a + 1 < argc) {
+            if (!parseCoreList(argv[++a], event_filter)) {
+                printf("bad core list: %s\n", argv[a]);
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[a], "--event-addrs") == 0 && a + 1 < argc) {
+            if (!parseRange(argv[++a], &event_filter.addrLow, &event_filter.addrHigh, 16)) {
+                printf("bad address range: %s (expected hex low-high)\n", argv[a]);
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[a], "--event-accesses") == 0 && a + 1 < argc) {
+            if (!parseRange(argv[++a], &event_filter.firstAccess, &event_filter.lastAccess, 10)) {
+                printf("bad access range: %s (expected first-last)\n", argv[a]);
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[a], "--checkpoint-at") == 0 && a + 1 < argc) {
+            checkpoint_at = strtoul(argv[++a], NULL, 10);
+            if (checkpoint_at == 0) {
+                printf("checkpoint access must be at least 1\n");
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[a], "--checkpoint-out") == 0 && a + 1 < argc) {
+            checkpoint_out = argv[++a];
+        }
+        else if (strcmp(argv[a], "--restore") == 0 && a + 1 < argc) {
+            restore_file = argv[++a];
+        }
+        else if (strcmp(argv[a], "--sample") == 0 && a + 1 < argc) {
+            vector<ulong> sample;
+            if (!parseSizeList(argv[++a], sample) || sample.size() != 2 || sample[1] == 0 || sample[1] >= sample[0]) {
+                printf("bad sampling: %s (expected period,window with window < period)\n", argv[a]);
+                exit(0);
+            }
+            sample_period = sample[0];
+            sample_window = sample[1];
+        }
+        else if (strcmp(argv[a], "--no-pipeline") == 0) {
+            pipeline = false;
+        }
+        else if (strcmp(argv[a], "--replacement") == 0 && a + 1 < argc) {
+            replacement = parseReplacement(argv[++a]);
+            if (replacement < 0) {
+                printf("unknown replacement policy: %s\n", argv[a]);
+                exit(0);
+            }
+        }
+        else {
+            printf("unknown option: %s\n", argv[a]);
+            exit(0);
+        }
+    }
 
     printf("===== 506 SMP Simulator configuration =====\n");
     // print out simulator configuration here
@@ -42,100 +762,120 @@ int main(int argc, char *argv[])
     printf("L1_ASSOC:               %lu\n", cache_assoc);
     printf("L1_BLOCKSIZE:           %lu\n", blk_size);
     printf("NUMBER OF PROCESSORS:   %lu\n", num_processors);
-    if     (protocol == 0) printf("COHERENCE PROTOCOL:     MSI\n");
-    else if(protocol == 1) printf("COHERENCE PROTOCOL:     Dragon\n");
+    printf("COHERENCE PROTOCOL:     %s", protocolName(protocols[0]));
+    for (ulong p = 1; p < protocols.size(); p++) printf(",%s", protocolName(protocols[p]));
+    printf("\n");
     printf("TRACE FILE:             %s\n",fname);
+    if (replacement != REPL_LRU) printf("REPLACEMENT POLICY:     %s\n", replacementName(replacement));
+    if (timing) printf("LATENCIES:              hit %lu, memory %lu, flush %lu, update %lu, bus %lu\n",
+                       latency.hit, latency.memory, latency.flush, latency.update, latency.bus);
+    if (cluster_size != 0) printf("CLUSTERS:               %lu of %lu cores\n", (num_processors + cluster_size - 1) / cluster_size, cluster_size);
+    if (llc_size != 0) printf("LLC:                    %lu, %lu-way, %s\n", llc_size, llc_assoc, llcModeName(llc_mode));
+    if (interval != 0) printf("INTERVALS:              every %lu accesses to %s\n", interval, interval_out);
+    if (event_file != NULL) printf("EVENT LOG:              %s\n", event_file);
+    if (checkpoint_at != 0) printf("CHECKPOINT:             after access %lu to %s\n", checkpoint_at, checkpoint_out);
+    if (restore_file != NULL) printf("RESTORE FROM:           %s\n", restore_file);
+    if (sample_period != 0) printf("SAMPLING:               %lu of every %lu accesses\n", sample_window, sample_period);
     
-    // Using pointers so that we can use inheritance */
-    // Create an array to store objects of cache class, using dynamic 
-    Cache** cacheArray = (Cache **) malloc(num_processors * sizeof(Cache));
-    for(ulong i = 0; i < num_processors; i++) {
-        // if(protocol == 0) {
-        // Create cache objects and insert into cacheArray
-        cacheArray[i] = new Cache(cache_size, cache_assoc, blk_size, protocol);
-        // }
-    }
-
-    // Open trace file
-    pFile = fopen (fname,"r");
-    if(pFile == 0)
+    // the estimates cover the L1 statistics and bus timing; the other analyses need every access
+    if (sample_period != 0 && (llc_size != 0 || classify_misses || false_sharing ||
+                               interval != 0 || event_file != NULL || checkpoint_at != 0)) {
+        printf("--sample cannot be combined with --llc, --classify-misses, --false-sharing, --interval, --events or --checkpoint-at\n");
+        exit(0);
+    }
+    if (num_processors > MAX_TRACE_CORES) {
+        printf("At most %lu processors are supported\n", MAX_TRACE_CORES);
+        exit(0);
+    }
+
+    // Open trace file (text or binary, detected from the header)
+    TraceReader *trace = TraceReader::open(fname);
+    if(trace == NULL)
     {   
         printf("Trace file problem\n");
         exit(0);
     }
-    
-    ulong proc; // Processor number
-    char op; // Operation (r, w)
-    ulong addr; // Address at which the operation is being performed
+    if (trace->getNumCores() > num_processors) {
+        printf("Trace file has %lu cores, but only %lu processors are simulated\n", trace->getNumCores(), num_processors);
+        exit(0);
+    }
+    trace->limitCores(num_processors);
+    SimConfig cfg;
+    cfg.cacheSize   = cache_size;
+    cfg.assoc       = cache_assoc;
+    cfg.blockSize   = blk_size;
+    cfg.numProcs    = num_processors;
+    cfg.replacement = replacement;
+    cfg.snoopFilter = snoop_filter;
+    cfg.timing      = timing;
+    cfg.latency     = latency;
+    cfg.llcSize     = llc_size;
+    cfg.llcAssoc    = llc_assoc;
+    cfg.llcMode     = llc_mode;
+    cfg.clusterSize = cluster_size;
+    cfg.classifyMisses = classify_misses;
+    cfg.falseSharing   = false_sharing;
+    cfg.checkpoint     = (checkpoint_at != 0);
+    cfg.samplePeriod   = sample_period;
+    cfg.sampleWindow   = sample_window;
 
-    int line = 1;
-    while(fscanf(pFile, "%lu %c %lx", &proc, &op, &addr) != EOF)
-    {
-#ifdef _DEBUG
-    printf("%d: Protocol:%lu Core:%lu Operation:%c Addr:%lx\n", line, protocol, proc, op, addr);
-#endif
-        // propagate request down through memory hierarchy
-        // by calling cachesArray[processor#]->Access(...)
-        int brdcastSig = 0;
-        if (protocol == 0) {
-            #ifdef _DEBUG
-                printf("\tBroadcast core %lu:\n", proc);
-            #endif
-            brdcastSig = cacheArray[proc]->AccessMCI(addr, op, protocol);
-            for (ulong i=0; i < num_processors; i++) {
-                if (i != proc) {
-                    #ifdef _DEBUG
-                        printf("\tSnooping core %lu:\n", i);
-                    #endif
-                    cacheArray[i]->SnoopMCI(addr, op, protocol, brdcastSig);
-                }
+    IntervalWriter *intervals = NULL;
+    if (interval != 0) {
+        intervals = IntervalWriter::open(interval_out, interval);
+        if (intervals == NULL) {
+            printf("Cannot write interval file %s\n", interval_out);
+            exit(0);
+        }
+    }
+
+    // one independent system per protocol, all fed from the same decoded trace
+    vector<SimulationRun *> runs;
+    vector<EventLog *> event_logs;
+    for (ulong p = 0; p < protocols.size(); p++) {
+        cfg.protocol = protocols[p];
+        cfg.events   = NULL;
+        if (event_file != NULL && protocols[p] < NUM_PROTOCOLS) {
+            string name = runFileName(event_file, protocols[p], protocols.size());
+            cfg.events = EventLog::open(name.c_str(), protocols[p], blk_size, event_filter);
+            if (cfg.events == NULL) {
+                printf("Cannot write event log %s\n", name.c_str());
+                exit(0);
             }
+            event_logs.push_back(cfg.events);
         }
-        else if (protocol == 1) {
-            #ifdef _DEBUG
-                printf("\tBroadcast core %lu:\n", proc);
-            #endif
-            bool C = false;
-            cacheLine * line = NULL;
-            for (ulong i=0; i < num_processors; i++) {
-                if (i != proc) {
-                    line = cacheArray[i]->findLine(addr);
-                    if(line != NULL) {
-                        C = true;
-                        break;
-                    }
-                }
+        SimulationRun *run = createRun(cfg, num_threads);
+        if (run == NULL) {
+            printf("Unknown protocol %lu\n", protocols[p]);
+            exit(0);
+        }
+        // warm start: every run has to resume at the same trace offset
+        if (restore_file != NULL) {
+            string name = runFileName(restore_file, protocols[p], protocols.size());
+            ulong offset;
+            if (!run->restore(name.c_str(), &offset)) {
+                printf("Cannot restore checkpoint %s\n", name.c_str());
+                exit(0);
             }
-            brdcastSig = cacheArray[proc]->AccessDGN(addr, op, protocol, C);
-            for (ulong i=0; i < num_processors; i++) {
-                if (i != proc) {
-                    #ifdef _DEBUG
-                        printf("\tSnooping core %lu:\n", i);
-                    #endif
-                    if (brdcastSig == 0b1101) { // case of BusRdBusUpd signal
-                    #ifdef _DEBUG
-                        printf("\t\t^^^ Bus read followed by bus upgrade encountered ^^^\n");
-                    #endif
-                        cacheArray[i]->SnoopDGN(addr, op, protocol, 0b1001);
-                        cacheArray[i]->SnoopDGN(addr, op, protocol, 0b1100);
-                    }
-                    else {
-                        cacheArray[i]->SnoopDGN(addr, op, protocol, brdcastSig);
-                    }
-                }
+            if (p > 0 && offset != trace_offset) {
+                printf("Checkpoint %s is at access %lu, not %lu\n", name.c_str(), offset, trace_offset);
+                exit(0);
             }
+            trace_offset = offset;
         }
-        line++;
+        if (checkpoint_at != 0) run->checkpointAt(checkpoint_at, runFileName(checkpoint_out, protocols[p], protocols.size()));
+        if (intervals != NULL) run->recordIntervals(intervals, p);
+        runs.push_back(run);
     }
-
-    fclose(pFile);
-
-    //********************************//
-    //print out all caches' statistics //
-    //********************************//
-    for (ulong i=0; i < num_processors; i++) {
-        cacheArray[i]->printStats(i, protocol);
+    if (trace_offset != 0) {
+        printf("RESTORED AT ACCESS:     %lu\n", trace_offset);
+        trace = new OffsetTraceReader(trace, trace_offset);
     }
+    // decode on a separate thread, overlapping I/O and parsing with simulation
+    if (pipeline) trace = new PipelinedTraceReader(trace);
+    runSimulation(runs, trace);
+    if (intervals != NULL) intervals->close();
+    for (ulong l = 0; l < event_logs.size(); l++) event_logs[l]->close();
+
     // Free all the dynamically allocated variables/memory
     // Use delete for allocation using new
     // Use free for allocation using free
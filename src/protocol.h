@@ -0,0 +1,245 @@
+/*******************************************************
+                          protocol.h
+********************************************************/
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "cache.h"
+
+/*
+Table-driven coherence protocols. Each protocol is a traits type holding two
+dense transition tables:
+   procTable[state][processor event]   for the requesting cache
+   snoopTable[state][bus event]        for every other cache holding the block
+An entry gives the next state, the bus transactions to broadcast (processor
+side only) and the counters to increment. State 0 is always I (block not
+present), so a miss is simply a lookup in row I. ProtocolCache is
+instantiated per protocol, so every table is a compile-time constant and
+adding a protocol adds no work to the access path.
+*/
+
+// Processor events: (op == 'w') << 1 | C, where C is the shared line
+enum {
+   PR_RD = 0,
+   PR_RD_C,
+   PR_WR,
+   PR_WR_C,
+   NUM_PROC_EVENTS
+};
+
+// Bus events, numbered so a transaction can be a mask of them; snoopers see
+// the set bits in increasing order, i.e. BusRd before BusUpd
+enum {
+   EV_BUSRD = 0,
+   EV_BUSRDX,
+   EV_BUSUPGR,
+   EV_BUSUPD,
+   NUM_BUS_EVENTS
+};
+const int BUS_NONE  = 0;
+const int BUS_RD    = 1 << EV_BUSRD;
+const int BUS_RDX   = 1 << EV_BUSRDX;
+const int BUS_UPGR  = 1 << EV_BUSUPGR;
+const int BUS_UPD   = 1 << EV_BUSUPD;
+
+// Counter updates of a transition
+const uint INC_RM    = 1 << CNT_READ_MISS;
+const uint INC_WM    = 1 << CNT_WRITE_MISS;
+const uint INC_WB    = 1 << CNT_WRITEBACK;
+const uint INC_MEM   = 1 << CNT_MEMTX;
+const uint INC_INV   = 1 << CNT_INVALIDATION;
+const uint INC_ITV   = 1 << CNT_INTERVENTION;
+const uint INC_FLUSH = 1 << CNT_FLUSH;
+const uint INC_RDX   = 1 << CNT_BUSRDX;
+const uint INC_UPD   = 1 << CNT_BUSUPD;
+const uint INC_UPGR  = 1 << CNT_BUSUPGR;
+
+struct Transition {
+   uchar next;          // next state
+   uchar bus;           // BUS_* mask to broadcast
+   uint16_t counters;   // INC_* mask
+};
+
+constexpr Transition T(int next, int bus = BUS_NONE, uint counters = 0)
+{
+   return Transition{(uchar) next, (uchar) bus, (uint16_t) counters};
+}
+
+/*
+Modified MSI (protocol 0). A write hit in C moves to M without a bus
+transaction, as in the reference outputs.
+*/
+struct MSIProtocol {
+   enum { I = 0, C, M, NUM_STATES };
+
+   static constexpr Transition procTable[NUM_STATES][NUM_PROC_EVENTS] = {
+      //         PrRd                              PrRd (C)                          PrWr                                        PrWr (C)
+      /* I */ {  T(C, BUS_RD, INC_RM | INC_MEM),   T(C, BUS_RD, INC_RM | INC_MEM),   T(M, BUS_RDX, INC_WM | INC_MEM | INC_RDX),  T(M, BUS_RDX, INC_WM | INC_MEM | INC_RDX) },
+      /* C */ {  T(C),                             T(C),                             T(M),                                       T(M) },
+      /* M */ {  T(M),                             T(M),                             T(M),                                       T(M) },
+   };
+   static constexpr Transition snoopTable[NUM_STATES][NUM_BUS_EVENTS] = {
+      //         BusRd                                         BusRdX                                        BusUpgr  BusUpd
+      /* I */ {  T(I),                                         T(I),                                         T(I),    T(I) },
+      /* C */ {  T(I, 0, INC_INV),                             T(I, 0, INC_INV),                             T(C),    T(C) },
+      /* M */ {  T(I, 0, INC_WB | INC_FLUSH | INC_MEM | INC_INV), T(I, 0, INC_WB | INC_FLUSH | INC_MEM | INC_INV), T(M), T(M) },
+   };
+   static constexpr uint dirtyStates = 1 << M;
+
+   static constexpr bool usesSharedSignal = false;   // no C line
+   static constexpr bool updateBased      = false;   // report invalidations and BusRdX
+   static constexpr bool writeThrough     = false;   // BusUpd also updates memory
+   static constexpr bool upgrades         = false;   // BusUpgr for writes to shared copies
+   static constexpr bool isDirty(int state)          { return (dirtyStates >> state) & 1; }
+   static const char *name()                         { return "MSI"; }
+   static const char *stateName(int state)           { static const char *n[] = {"I", "C", "M"}; return n[state]; }
+};
+
+/*
+Dragon (protocol 1), update based. A write miss to a shared block
+broadcasts BusRd followed by BusUpd.
+*/
+struct DragonProtocol {
+   enum { I = 0, E, Sc, Sm, M, NUM_STATES };
+
+   static constexpr Transition procTable[NUM_STATES][NUM_PROC_EVENTS] = {
+      //          PrRd                              PrRd (C)                           PrWr                              PrWr (C)
+      /* I  */ {  T(E, BUS_RD, INC_RM | INC_MEM),   T(Sc, BUS_RD, INC_RM | INC_MEM),   T(M, BUS_RD, INC_WM | INC_MEM),   T(Sm, BUS_RD | BUS_UPD, INC_WM | INC_MEM | INC_UPD) },
+      /* E  */ {  T(E),                             T(E),                              T(M),                             T(M) },
+      /* Sc */ {  T(Sc),                            T(Sc),                             T(M, BUS_UPD, INC_UPD),           T(Sm, BUS_UPD, INC_UPD) },
+      /* Sm */ {  T(Sm),                            T(Sm),                             T(M, BUS_UPD, INC_UPD),           T(Sm, BUS_UPD, INC_UPD) },
+      /* M  */ {  T(M),                             T(M),                              T(M),                             T(M) },
+   };
+   static constexpr Transition snoopTable[NUM_STATES][NUM_BUS_EVENTS] = {
+      //          BusRd                                             BusRdX  BusUpgr  BusUpd
+      /* I  */ {  T(I),                                             T(I),   T(I),    T(I) },
+      /* E  */ {  T(Sc, 0, INC_ITV),                                T(E),   T(E),    T(E) },
+      /* Sc */ {  T(Sc),                                            T(Sc),  T(Sc),   T(Sc) },
+      /* Sm */ {  T(Sm, 0, INC_FLUSH | INC_WB | INC_MEM),           T(Sm),  T(Sm),   T(Sc) },
+      /* M  */ {  T(Sm, 0, INC_ITV | INC_FLUSH | INC_WB | INC_MEM), T(M),   T(M),    T(M) },
+   };
+   static constexpr uint dirtyStates = (1 << Sm) | (1 << M);
+
+   static constexpr bool usesSharedSignal = true;    // C line
+   static constexpr bool updateBased      = true;    // report interventions and BusUpd
+   static constexpr bool writeThrough     = false;
+   static constexpr bool upgrades         = false;
+   static constexpr bool isDirty(int state)          { return (dirtyStates >> state) & 1; }
+   static const char *name()                         { return "Dragon"; }
+   static const char *stateName(int state)           { static const char *n[] = {"I", "E", "Sc", "Sm", "M"}; return n[state]; }
+};
+
+/*
+MESI (protocol 2), invalidation based with BusUpgr for writes to S
+*/
+struct MESIProtocol {
+   enum { I = 0, S, E, M, NUM_STATES };
+
+   static constexpr Transition procTable[NUM_STATES][NUM_PROC_EVENTS] = {
+      //         PrRd                              PrRd (C)                          PrWr                                        PrWr (C)
+      /* I */ {  T(E, BUS_RD, INC_RM | INC_MEM),   T(S, BUS_RD, INC_RM | INC_MEM),   T(M, BUS_RDX, INC_WM | INC_MEM | INC_RDX),  T(M, BUS_RDX, INC_WM | INC_MEM | INC_RDX) },
+      /* S */ {  T(S),                             T(S),                             T(M, BUS_UPGR, INC_UPGR),                   T(M, BUS_UPGR, INC_UPGR) },
+      /* E */ {  T(E),                             T(E),                             T(M),                                       T(M) },
+      /* M */ {  T(M),                             T(M),                             T(M),                                       T(M) },
+   };
+   static constexpr Transition snoopTable[NUM_STATES][NUM_BUS_EVENTS] = {
+      //         BusRd                                             BusRdX                                            BusUpgr           BusUpd
+      /* I */ {  T(I),                                             T(I),                                             T(I),             T(I) },
+      /* S */ {  T(S),                                             T(I, 0, INC_INV),                                 T(I, 0, INC_INV), T(S) },
+      /* E */ {  T(S, 0, INC_ITV),                                 T(I, 0, INC_INV),                                 T(E),             T(E) },
+      /* M */ {  T(S, 0, INC_ITV | INC_FLUSH | INC_WB | INC_MEM),  T(I, 0, INC_INV | INC_FLUSH | INC_WB | INC_MEM),  T(M),             T(M) },
+   };
+   static constexpr uint dirtyStates = 1 << M;
+
+   static constexpr bool usesSharedSignal = true;
+   static constexpr bool updateBased      = false;
+   static constexpr bool writeThrough     = false;
+   static constexpr bool upgrades         = true;
+   static constexpr bool isDirty(int state)          { return (dirtyStates >> state) & 1; }
+   static const char *name()                         { return "MESI"; }
+   static const char *stateName(int state)           { static const char *n[] = {"I", "S", "E", "M"}; return n[state]; }
+};
+
+/*
+MOESI (protocol 3). The owner (M or O) supplies the block by flushing it on
+the bus without writing it back, so O defers the writeback to its eviction.
+*/
+struct MOESIProtocol {
+   enum { I = 0, S, E, O, M, NUM_STATES };
+
+   static constexpr Transition procTable[NUM_STATES][NUM_PROC_EVENTS] = {
+      //         PrRd                              PrRd (C)                          PrWr                                        PrWr (C)
+      /* I */ {  T(E, BUS_RD, INC_RM | INC_MEM),   T(S, BUS_RD, INC_RM | INC_MEM),   T(M, BUS_RDX, INC_WM | INC_MEM | INC_RDX),  T(M, BUS_RDX, INC_WM | INC_MEM | INC_RDX) },
+      /* S */ {  T(S),                             T(S),                             T(M, BUS_UPGR, INC_UPGR),                   T(M, BUS_UPGR, INC_UPGR) },
+      /* E */ {  T(E),                             T(E),                             T(M),                                       T(M) },
+      /* O */ {  T(O),                             T(O),                             T(M, BUS_UPGR, INC_UPGR),                   T(M, BUS_UPGR, INC_UPGR) },
+      /* M */ {  T(M),                             T(M),                             T(M),                                       T(M) },
+   };
+   static constexpr Transition snoopTable[NUM_STATES][NUM_BUS_EVENTS] = {
+      //         BusRd                           BusRdX                          BusUpgr           BusUpd
+      /* I */ {  T(I),                           T(I),                           T(I),             T(I) },
+      /* S */ {  T(S),                           T(I, 0, INC_INV),               T(I, 0, INC_INV), T(S) },
+      /* E */ {  T(S, 0, INC_ITV),               T(I, 0, INC_INV),               T(E),             T(E) },
+      /* O */ {  T(O, 0, INC_FLUSH),             T(I, 0, INC_INV | INC_FLUSH),   T(I, 0, INC_INV), T(O) },
+      /* M */ {  T(O, 0, INC_ITV | INC_FLUSH),   T(I, 0, INC_INV | INC_FLUSH),   T(M),             T(M) },
+   };
+   static constexpr uint dirtyStates = (1 << O) | (1 << M);
+
+   static constexpr bool usesSharedSignal = true;
+   static constexpr bool updateBased      = false;
+   static constexpr bool writeThrough     = false;
+   static constexpr bool upgrades         = true;
+   static constexpr bool isDirty(int state)          { return (dirtyStates >> state) & 1; }
+   static const char *name()                         { return "MOESI"; }
+   static const char *stateName(int state)           { static const char *n[] = {"I", "S", "E", "O", "M"}; return n[state]; }
+};
+
+/*
+Firefly (protocol 4), update based. Writes to shared blocks are written
+through to memory and to the other copies with BusUpd, so S is always clean
+and only the exclusive D state is dirty. A shared write miss counts one
+memory transaction for the combined fetch and write-through.
+*/
+struct FireflyProtocol {
+   enum { I = 0, V, S, D, NUM_STATES };
+
+   static constexpr Transition procTable[NUM_STATES][NUM_PROC_EVENTS] = {
+      //         PrRd                              PrRd (C)                          PrWr                              PrWr (C)
+      /* I */ {  T(V, BUS_RD, INC_RM | INC_MEM),   T(S, BUS_RD, INC_RM | INC_MEM),   T(D, BUS_RD, INC_WM | INC_MEM),   T(S, BUS_RD | BUS_UPD, INC_WM | INC_MEM | INC_UPD) },
+      /* V */ {  T(V),                             T(V),                             T(D),                             T(D) },
+      /* S */ {  T(S),                             T(S),                             T(V, BUS_UPD, INC_UPD | INC_MEM), T(S, BUS_UPD, INC_UPD | INC_MEM) },
+      /* D */ {  T(D),                             T(D),                             T(D),                             T(D) },
+   };
+   static constexpr Transition snoopTable[NUM_STATES][NUM_BUS_EVENTS] = {
+      //         BusRd                                            BusRdX  BusUpgr  BusUpd
+      /* I */ {  T(I),                                            T(I),   T(I),    T(I) },
+      /* V */ {  T(S, 0, INC_ITV),                                T(V),   T(V),    T(V) },
+      /* S */ {  T(S),                                            T(S),   T(S),    T(S) },
+      /* D */ {  T(S, 0, INC_ITV | INC_FLUSH | INC_WB | INC_MEM), T(D),   T(D),    T(D) },
+   };
+   static constexpr uint dirtyStates = 1 << D;
+
+   static constexpr bool usesSharedSignal = true;
+   static constexpr bool updateBased      = true;
+   static constexpr bool writeThrough     = true;
+   static constexpr bool upgrades         = false;
+   static constexpr bool isDirty(int state)          { return (dirtyStates >> state) & 1; }
+   static const char *name()                         { return "Firefly"; }
+   static const char *stateName(int state)           { static const char *n[] = {"I", "V", "S", "D"}; return n[state]; }
+};
+
+// Protocol numbers accepted on the command line
+enum {
+   PROTO_MSI = 0,
+   PROTO_DRAGON,
+   PROTO_MESI,
+   PROTO_MOESI,
+   PROTO_FIREFLY,
+   NUM_PROTOCOLS
+};
+const char *protocolName(ulong);
+// Name of state in the given protocol
+const char *protocolStateName(ulong protocol, int state);
+
+#endif
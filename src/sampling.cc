@@ -0,0 +1,88 @@
+/*******************************************************
+                          sampling.cc
+********************************************************/
+
+#include <stdio.h>
+#include <math.h>
+#include "sampling.h"
+using namespace std;
+
+// Two-sided 95% quantile of the normal distribution
+const double CONFIDENCE_Z = 1.96;
+
+SampledStats::SampledStats(ulong procs, ulong windowLength, bool withTiming)
+{
+   numProcs = procs;
+   window   = windowLength;
+   windows  = 0;
+   timing   = withTiming;
+   sum.assign(numProcs * SAMPLED_VALUES, 0.0);
+   sumSquares.assign(numProcs * SAMPLED_VALUES, 0.0);
+}
+
+void SampledStats::addWindow(const vector<ulong> &deltas)
+{
+   for (ulong i = 0; i < sum.size(); i++) {
+      double rate = (double) deltas[i] / window;
+      sum[i]        += rate;
+      sumSquares[i] += rate * rate;
+   }
+   windows++;
+}
+
+void SampledStats::estimate(ulong proc, int value, ulong accesses, double *total, double *error)
+{
+   ulong i = proc * SAMPLED_VALUES + value;
+   double mean = windows ? sum[i] / windows : 0.0;
+   double variance = (windows > 1) ? (sumSquares[i] - windows * mean * mean) / (windows - 1) : 0.0;
+   if (variance < 0) variance = 0;   // rounding
+   *total = mean * accesses;
+   *error = (windows > 0) ? CONFIDENCE_Z * sqrt(variance / windows) * accesses : 0.0;
+}
+
+void SampledStats::printStats(ulong proc, ulong accesses, bool updateBased, bool upgrades)
+{
+   double estimate[SAMPLED_VALUES], error[SAMPLED_VALUES];
+   for (int v = 0; v < SAMPLED_VALUES; v++) this->estimate(proc, v, accesses, &estimate[v], &error[v]);
+   double refs   = estimate[CNT_READ] + estimate[CNT_WRITE];
+   double misses = estimate[CNT_READ_MISS] + estimate[CNT_WRITE_MISS];
+
+   printf("============ Sampled results (Cache %lu) ============\n", proc);
+   printf("01. number of reads:                            %.0f +/- %.0f\n", estimate[CNT_READ], error[CNT_READ]);
+   printf("02. number of read misses:                      %.0f +/- %.0f\n", estimate[CNT_READ_MISS], error[CNT_READ_MISS]);
+   printf("03. number of writes:                           %.0f +/- %.0f\n", estimate[CNT_WRITE], error[CNT_WRITE]);
+   printf("04. number of write misses:                     %.0f +/- %.0f\n", estimate[CNT_WRITE_MISS], error[CNT_WRITE_MISS]);
+   printf("05. total miss rate:                            %.2f%%\n", refs > 0 ? 100.0 * misses / refs : 0.0);
+   printf("06. number of writebacks:                       %.0f +/- %.0f\n", estimate[CNT_WRITEBACK], error[CNT_WRITEBACK]);
+   printf("07. number of memory transactions:              %.0f +/- %.0f\n", estimate[CNT_MEMTX], error[CNT_MEMTX]);
+   if (!updateBased) {
+      printf("08. number of invalidations:                    %.0f +/- %.0f\n", estimate[CNT_INVALIDATION], error[CNT_INVALIDATION]);
+   }
+   else {
+      printf("08. number of interventions:                    %.0f +/- %.0f\n", estimate[CNT_INTERVENTION], error[CNT_INTERVENTION]);
+   }
+   printf("09. number of flushes:                          %.0f +/- %.0f\n", estimate[CNT_FLUSH], error[CNT_FLUSH]);
+   if (!updateBased) {
+      printf("10. number of BusRdX:                           %.0f +/- %.0f\n", estimate[CNT_BUSRDX], error[CNT_BUSRDX]);
+   }
+   else {
+      printf("10. number of Bus Transactions(BusUpd):         %.0f +/- %.0f\n", estimate[CNT_BUSUPD], error[CNT_BUSUPD]);
+   }
+   int line = 11;
+   if (upgrades) {
+      printf("%02d. number of BusUpgr:                          %.0f +/- %.0f\n", line++, estimate[CNT_BUSUPGR], error[CNT_BUSUPGR]);
+   }
+   if (timing) {
+      printf("%02d. number of execution cycles:                 %.0f +/- %.0f\n", line++, estimate[SAMPLE_CYCLES], error[SAMPLE_CYCLES]);
+      printf("%02d. number of bus wait cycles:                  %.0f +/- %.0f\n", line++, estimate[SAMPLE_WAIT_CYCLES], error[SAMPLE_WAIT_CYCLES]);
+   }
+}
+
+void SampledStats::printSummary(ulong accesses, ulong period)
+{
+   printf("============ Sampling ============\n");
+   printf("number of windows:                              %lu\n", windows);
+   printf("accesses simulated in detail:                   %lu of %lu (%.2f%%)\n", windows * window, accesses,
+          accesses ? 100.0 * windows * window / accesses : 0.0);
+   printf("confidence intervals:                           95%%, window of %lu in every %lu accesses\n", window, period);
+}
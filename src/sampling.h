@@ -0,0 +1,49 @@
+/*******************************************************
+                          sampling.h
+********************************************************/
+
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <vector>
+#include "cache.h"
+
+// Values estimated per core by sampling: the counters CNT_READ up to
+// CNT_BUSUPGR, then the execution and bus wait cycles of a bus timer
+const int SAMPLED_COUNTERS = CNT_BUSUPGR + 1;
+enum {
+   SAMPLE_CYCLES = SAMPLED_COUNTERS,
+   SAMPLE_WAIT_CYCLES,
+   SAMPLED_VALUES
+};
+
+/*
+Systematic sampling: of every period accesses, the last window are
+simulated in detail and the rest only functionally warm the caches, which
+keeps their contents exact. Each window contributes a per-access rate of
+every value; a total is estimated as the mean rate times the trace
+length, with a 95% confidence interval from the spread of the window rates.
+The bus timer only runs in the windows, which concatenates them in time.
+*/
+class SampledStats
+{
+protected:
+   ulong numProcs, window, windows;
+   bool timing;
+   std::vector<double> sum, sumSquares;   // [core * SAMPLED_VALUES + value]
+
+   // estimate and 95% half-width of one value for a trace of accesses
+   void estimate(ulong proc, int value, ulong accesses, double *total, double *error);
+
+public:
+   SampledStats(ulong procs, ulong windowLength, bool withTiming);
+
+   // Record the counter deltas of one window, laid out as sum
+   void addWindow(const std::vector<ulong> &deltas);
+   ulong getWindows()   { return windows; }
+   // Print the estimated statistics of one cache for a trace of accesses
+   void printStats(ulong proc, ulong accesses, bool updateBased, bool upgrades);
+   void printSummary(ulong accesses, ulong period);
+};
+
+#endif
@@ -0,0 +1,86 @@
+/*******************************************************
+                          sharing.cc
+********************************************************/
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "sharing.h"
+using namespace std;
+
+SharingDetector::SharingDetector(ulong blkSize)
+{
+   blockSize = blkSize;
+   memset(events, 0, sizeof(events));
+}
+
+static ulong totalFalse(const ulong *falseEvents)
+{
+   ulong n = 0;
+   for (int e = 0; e < NUM_SHARE_EVENTS; e++) n += falseEvents[e];
+   return n;
+}
+
+void SharingDetector::record(int event, bool trueSharing, ulong block)
+{
+   events[event][trueSharing]++;
+   BlockCounts &b = blocks[block];   // value-initialized on first use
+   if (trueSharing) b.trueEvents++;
+   else             b.falseEvents[event]++;
+   if (blocks.size() > SHARING_BLOCK_LIMIT) prune();
+}
+
+void SharingDetector::prune()
+{
+   // rank by (count, block) so ties are broken and exactly half goes
+   vector< pair<ulong, ulong> > ranked;
+   ranked.reserve(blocks.size());
+   for (unordered_map<ulong, BlockCounts>::iterator it = blocks.begin(); it != blocks.end(); ++it) {
+      ranked.push_back(make_pair(totalFalse(it->second.falseEvents), it->first));
+   }
+   ulong drop = ranked.size() / 2;
+   nth_element(ranked.begin(), ranked.begin() + drop, ranked.end());
+   for (ulong i = 0; i < drop; i++) blocks.erase(ranked[i].second);
+}
+
+void SharingDetector::mergeStats(SharingDetector *other)
+{
+   for (int e = 0; e < NUM_SHARE_EVENTS; e++) {
+      events[e][0] += other->events[e][0];
+      events[e][1] += other->events[e][1];
+   }
+   for (unordered_map<ulong, BlockCounts>::iterator it = other->blocks.begin(); it != other->blocks.end(); ++it) {
+      BlockCounts &b = blocks[it->first];
+      for (int e = 0; e < NUM_SHARE_EVENTS; e++) b.falseEvents[e] += it->second.falseEvents[e];
+      b.trueEvents += it->second.trueEvents;
+   }
+   if (blocks.size() > SHARING_BLOCK_LIMIT) prune();
+}
+
+void SharingDetector::printStats()
+{
+   printf("============ Sharing analysis ============\n");
+   printf("01. number of true sharing invalidations:       %lu\n", events[SHARE_INV][1]);
+   printf("02. number of false sharing invalidations:      %lu\n", events[SHARE_INV][0]);
+   printf("03. number of true sharing interventions:       %lu\n", events[SHARE_ITV][1]);
+   printf("04. number of false sharing interventions:      %lu\n", events[SHARE_ITV][0]);
+   printf("05. number of true sharing updates:             %lu\n", events[SHARE_UPD][1]);
+   printf("06. number of false sharing updates:            %lu\n", events[SHARE_UPD][0]);
+
+   // rank the blocks by false-sharing events, ties by address
+   vector< pair<ulong, ulong> > ranked;   // (~count, block) sorts descending by count
+   for (unordered_map<ulong, BlockCounts>::iterator it = blocks.begin(); it != blocks.end(); ++it) {
+      ulong n = totalFalse(it->second.falseEvents);
+      if (n != 0) ranked.push_back(make_pair(~n, it->first));
+   }
+   ulong top = min((ulong) ranked.size(), FALSE_SHARING_TOP);
+   partial_sort(ranked.begin(), ranked.begin() + top, ranked.end());
+
+   printf("============ Top false-sharing blocks ============\n");
+   for (ulong i = 0; i < top; i++) {
+      const BlockCounts &b = blocks[ranked[i].second];
+      printf("block 0x%lx: %lu false (%lu inv, %lu itv, %lu upd), %lu true\n",
+             ranked[i].second * blockSize, totalFalse(b.falseEvents),
+             b.falseEvents[SHARE_INV], b.falseEvents[SHARE_ITV], b.falseEvents[SHARE_UPD], b.trueEvents);
+   }
+}
@@ -0,0 +1,71 @@
+/*******************************************************
+                          sharing.h
+********************************************************/
+
+#ifndef SHARING_H
+#define SHARING_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unordered_map>
+#include "cache.h"
+
+/****coherence events told apart by the detector****/
+enum {
+   SHARE_INV = 0,   // a snooped transaction invalidated the copy
+   SHARE_ITV,       // the copy supplied (flushed) its data
+   SHARE_UPD,       // the copy received a BusUpd
+   NUM_SHARE_EVENTS
+};
+
+// Number of offending blocks listed in the report
+const ulong FALSE_SHARING_TOP = 10;
+// Blocks with per-block counts kept before the least offending half is dropped
+const ulong SHARING_BLOCK_LIMIT = 1 << 16;
+
+/*
+False-sharing detector. Every L1 line carries a bitmap of the words its
+core read and one of the words it wrote since the block was filled (see
+Cache::recordWord), so that memory is bounded by the number of live lines.
+
+A coherence event on a snooper's copy is true sharing when the two cores
+communicate through the accessed word: for a write, the snooper read or
+wrote that word; for a read, the snooper wrote it. Otherwise the event
+only happened because different words share the block, i.e. false
+sharing. Reads that hit a copy which wrote nothing (e.g. MSI dropping a
+clean copy on BusRd) are protocol effects and are not counted. A
+supplied block clears the snooper's written-word bitmap, since those
+writes have now been passed on.
+
+The totals are exact. The per-block counts behind the report start at a
+block's first event of either kind; once SHARING_BLOCK_LIMIT blocks are
+tracked, the half with the fewest false-sharing events is dropped, so the
+table stays bounded on large footprints and a dropped block that comes
+back starts counting again.
+*/
+class SharingDetector
+{
+protected:
+   struct BlockCounts {
+      ulong falseEvents[NUM_SHARE_EVENTS];
+      ulong trueEvents;
+   };
+
+   ulong blockSize;
+   ulong events[NUM_SHARE_EVENTS][2];   // [event][true sharing]
+   // per-block counts of recently offending blocks
+   std::unordered_map<ulong, BlockCounts> blocks;
+
+   // drop the blocks with the fewest false-sharing events
+   void prune();
+
+public:
+   SharingDetector(ulong blkSize);
+
+   void record(int event, bool trueSharing, ulong block);
+   // Accumulate the counts of another detector (used to merge set shards)
+   void mergeStats(SharingDetector *);
+   void printStats();
+};
+
+#endif
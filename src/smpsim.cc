@@ -0,0 +1,157 @@
+/*******************************************************
+                          smpsim.cc
+********************************************************/
+
+#include "smpsim.h"
+#include "system.h"
+#include "protocol.h"
+
+static_assert((int) SMP_NUM_COUNTERS == (int) CNT_INTER_CLUSTER + 1 && (int) SMP_BUSUPGR == (int) CNT_BUSUPGR, "SMP_* counters must follow CNT_*");
+static_assert((int) SMP_FIREFLY == (int) PROTO_FIREFLY, "SMP_* protocols must follow PROTO_*");
+
+// The handle behind the C API: one system specialized for its protocol
+struct smp_system {
+   ulong numProcs;
+
+   virtual ~smp_system() {}
+   virtual size_t access(const uint32_t *cores, const char *ops, const uint64_t *addrs, size_t n) = 0;
+   virtual uint64_t counter(ulong core, int c) = 0;
+   virtual uint64_t cycles(ulong core) = 0;
+   virtual void reset() = 0;
+};
+
+template <class P>
+class ProtocolSystem : public smp_system
+{
+protected:
+   CacheSystem<P> *sys;
+
+public:
+   ProtocolSystem(const SimConfig &cfg)
+   {
+      sys      = createSystem<P>(cfg);
+      numProcs = cfg.numProcs;
+   }
+   ~ProtocolSystem() { destroySystem(sys); }
+
+   size_t access(const uint32_t *cores, const char *ops, const uint64_t *addrs, size_t n)
+   {
+      for (size_t i = 0; i < n; i++) {
+         if (cores[i] >= numProcs || (ops[i] != 'r' && ops[i] != 'w')) return i;
+         simulateAccess(sys, cores[i], ops[i], addrs[i]);
+      }
+      return n;
+   }
+
+   uint64_t counter(ulong core, int c)   { return sys->caches[core]->getCounter(c); }
+   uint64_t cycles(ulong core)           { return sys->timer != NULL ? sys->timer->getCycles(core) : 0; }
+
+   void reset()
+   {
+      for (ulong i = 0; i < numProcs; i++) sys->caches[i]->reset();
+      if (sys->directory != NULL) sys->directory->clear();
+      if (sys->timer != NULL)     sys->timer->reset();
+      if (sys->llc != NULL)       sys->llc->reset();
+   }
+};
+
+// A geometry the Cache constructor accepts: power of two block size and
+// set count, and the associativity limits of the PLRU policies. Bit-PLRU
+// needs at least two ways for its MRU bits to pick a victim from.
+static bool validGeometry(ulong size, ulong assoc, ulong blockSize, int policy)
+{
+   if (size == 0 || assoc == 0 || blockSize == 0 || (blockSize & (blockSize - 1)) != 0) return false;
+   ulong sets = size / blockSize / assoc;
+   if (sets == 0 || (sets & (sets - 1)) != 0 || sets * assoc * blockSize != size) return false;
+   if (policy == REPL_BIT_PLRU && assoc < 2) return false;
+   if (policy == REPL_TREE_PLRU || policy == REPL_BIT_PLRU) return assoc <= 64 && (assoc & (assoc - 1)) == 0;
+   return true;
+}
+
+extern "C" {
+
+void smp_default_config(smp_config *cfg)
+{
+   BusLatencies latency = defaultLatencies();
+   cfg->cache_size   = 8192;
+   cfg->assoc        = 8;
+   cfg->block_size   = 64;
+   cfg->num_procs    = 4;
+   cfg->protocol     = SMP_MSI;
+   cfg->replacement  = "lru";
+   cfg->snoop_filter = 0;
+   cfg->cluster_size = 0;
+   cfg->timing       = 0;
+   cfg->latency[0]   = latency.hit;
+   cfg->latency[1]   = latency.memory;
+   cfg->latency[2]   = latency.flush;
+   cfg->latency[3]   = latency.update;
+   cfg->latency[4]   = latency.bus;
+   cfg->llc_size     = 0;
+   cfg->llc_assoc    = 0;
+   cfg->llc_mode     = "inclusive";
+}
+
+smp_system *smp_create(const smp_config *c)
+{
+   SimConfig cfg = SimConfig();
+   cfg.cacheSize   = c->cache_size;
+   cfg.assoc       = c->assoc;
+   cfg.blockSize   = c->block_size;
+   cfg.numProcs    = c->num_procs;
+   cfg.protocol    = c->protocol;
+   cfg.replacement = (c->replacement != NULL) ? parseReplacement(c->replacement) : REPL_LRU;
+   cfg.snoopFilter = c->snoop_filter != 0;
+   cfg.clusterSize = c->cluster_size;
+   cfg.timing      = c->timing != 0;
+   cfg.latency.hit    = c->latency[0];
+   cfg.latency.memory = c->latency[1];
+   cfg.latency.flush  = c->latency[2];
+   cfg.latency.update = c->latency[3];
+   cfg.latency.bus    = c->latency[4];
+   cfg.llcSize     = c->llc_size;
+   cfg.llcAssoc    = c->llc_assoc;
+   cfg.llcMode     = (c->llc_mode != NULL) ? parseLLCMode(c->llc_mode) : LLC_INCLUSIVE;
+   cfg.events      = NULL;
+
+   if (cfg.numProcs == 0 || cfg.numProcs > MAX_TRACE_CORES || cfg.replacement < 0 || cfg.llcMode < 0) return NULL;
+   if (!validGeometry(cfg.cacheSize, cfg.assoc, cfg.blockSize, cfg.replacement)) return NULL;
+   if (cfg.llcSize != 0 && !validGeometry(cfg.llcSize, cfg.llcAssoc, cfg.blockSize, cfg.replacement)) return NULL;
+
+   switch (cfg.protocol) {
+      case PROTO_MSI:     return new ProtocolSystem<MSIProtocol>(cfg);
+      case PROTO_DRAGON:  return new ProtocolSystem<DragonProtocol>(cfg);
+      case PROTO_MESI:    return new ProtocolSystem<MESIProtocol>(cfg);
+      case PROTO_MOESI:   return new ProtocolSystem<MOESIProtocol>(cfg);
+      case PROTO_FIREFLY: return new ProtocolSystem<FireflyProtocol>(cfg);
+      default:            return NULL;
+   }
+}
+
+void smp_destroy(smp_system *sys)
+{
+   delete sys;
+}
+
+size_t smp_access(smp_system *sys, const uint32_t *cores, const char *ops, const uint64_t *addrs, size_t n)
+{
+   return sys->access(cores, ops, addrs, n);
+}
+
+uint64_t smp_counter(smp_system *sys, unsigned long core, int counter)
+{
+   if (core >= sys->numProcs || counter < 0 || counter >= SMP_NUM_COUNTERS) return 0;
+   return sys->counter(core, counter);
+}
+
+uint64_t smp_cycles(smp_system *sys, unsigned long core)
+{
+   return (core < sys->numProcs) ? sys->cycles(core) : 0;
+}
+
+void smp_reset(smp_system *sys)
+{
+   sys->reset();
+}
+
+}
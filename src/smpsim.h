@@ -0,0 +1,94 @@
+/*******************************************************
+                          smpsim.h
+********************************************************/
+
+#ifndef SMPSIM_H
+#define SMPSIM_H
+
+/*
+Embeddable coherence simulator: the private caches of all cores and their
+snooping bus (see system.h) behind a small C API, so a tool can feed
+accesses straight from memory instead of writing a trace file. Link with
+libsmpsim.a (make libsmpsim.a) and the C++ runtime.
+
+A system is not thread safe, but independent systems can be driven from
+different threads.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* coherence protocols, as on the command line */
+enum {
+   SMP_MSI = 0,
+   SMP_DRAGON,
+   SMP_MESI,
+   SMP_MOESI,
+   SMP_FIREFLY
+};
+
+/* counters of one cache, in the order of CNT_* in cache.h */
+enum {
+   SMP_READS = 0,
+   SMP_READ_MISSES,
+   SMP_WRITES,
+   SMP_WRITE_MISSES,
+   SMP_WRITEBACKS,
+   SMP_MEMORY_TRANSACTIONS,
+   SMP_INVALIDATIONS,
+   SMP_INTERVENTIONS,
+   SMP_FLUSHES,
+   SMP_BUSRDX,
+   SMP_BUSUPD,
+   SMP_BUSUPGR,
+   SMP_INTRA_CLUSTER,     /* with cluster_size only */
+   SMP_INTER_CLUSTER,
+   SMP_NUM_COUNTERS
+};
+
+typedef struct smp_config {
+   unsigned long cache_size, assoc, block_size;   /* L1 geometry in bytes and ways */
+   unsigned long num_procs;
+   int protocol;                 /* SMP_MSI .. SMP_FIREFLY */
+   const char *replacement;      /* lru, tree-plru, bit-plru (2+ ways) or srrip */
+   int snoop_filter;             /* non-zero: snoop only the actual sharers */
+   unsigned long cluster_size;   /* cores per snooping cluster, 0: one flat bus */
+   int timing;                   /* non-zero: bus timing, see smp_cycles */
+   unsigned long latency[5];     /* hit, memory, flush, update, bus cycles */
+   unsigned long llc_size, llc_assoc;   /* shared LLC, llc_size 0: none */
+   const char *llc_mode;         /* inclusive, non-inclusive or exclusive */
+} smp_config;
+
+typedef struct smp_system smp_system;
+
+/* The command line defaults: 8192B 8-way L1s with 64B blocks, 4 cores, MSI */
+void smp_default_config(smp_config *cfg);
+
+/* Build a system, NULL if the configuration is invalid */
+smp_system *smp_create(const smp_config *cfg);
+void smp_destroy(smp_system *sys);
+
+/*
+Simulate n accesses in order: core cores[i] reads (ops[i] == 'r') or
+writes ('w') address addrs[i]. Returns the number simulated, which is
+less than n if access i has an unknown core or operation.
+*/
+size_t smp_access(smp_system *sys, const uint32_t *cores, const char *ops, const uint64_t *addrs, size_t n);
+
+/* Counter SMP_* of the cache of core, 0 for an unknown core or counter */
+uint64_t smp_counter(smp_system *sys, unsigned long core, int counter);
+/* Execution cycles of core with timing, 0 without */
+uint64_t smp_cycles(smp_system *sys, unsigned long core);
+
+/* Empty all caches and zero every counter and clock, without reallocating */
+void smp_reset(smp_system *sys);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
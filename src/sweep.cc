@@ -0,0 +1,165 @@
+/*******************************************************
+                          sweep.cc
+********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "sweep.h"
+using namespace std;
+
+static bool isPow2(ulong x)   { return x != 0 && (x & (x - 1)) == 0; }
+
+StackDistanceSweep::StackDistanceSweep(ulong procs, const vector<ulong> &sizes, const vector<ulong> &assocs,
+                                       const vector<ulong> &blocks, bool inval)
+{
+   numProcs   = procs;
+   invalidate = inval;
+   reads = writes = 0;
+
+   // enumerate the valid geometries (power of two sets, as in Cache) and
+   // group them by block size and set count
+   for (ulong b = 0; b < blocks.size(); b++) {
+      if (!isPow2(blocks[b])) continue;
+      for (ulong s = 0; s < sizes.size(); s++) {
+         for (ulong a = 0; a < assocs.size(); a++) {
+            ulong bytesPerSet = assocs[a] * blocks[b];
+            if (sizes[s] % bytesPerSet != 0 || !isPow2(sizes[s] / bytesPerSet)) continue;
+            if (assocs[a] > UINT16_MAX) continue;
+
+            Config c;
+            c.size      = sizes[s];
+            c.assoc     = assocs[a];
+            c.blockSize = blocks[b];
+            c.group     = NULL;
+            ulong log2Blk = __builtin_ctzl(blocks[b]);
+            ulong sets    = sizes[s] / bytesPerSet;
+            for (ulong g = 0; g < groups.size(); g++) {
+               if (groups[g]->log2Blk == log2Blk && groups[g]->sets == sets) c.group = groups[g];
+            }
+            if (c.group == NULL) {
+               c.group = new Group;
+               c.group->log2Blk = log2Blk;
+               c.group->sets    = sets;
+               c.group->depth   = 0;
+               groups.push_back(c.group);
+            }
+            if (c.assoc > c.group->depth) c.group->depth = c.assoc;
+            configs.push_back(c);
+         }
+      }
+   }
+
+   for (ulong g = 0; g < groups.size(); g++) {
+      Group *grp = groups[g];
+      ulong stacks = numProcs * grp->sets;
+      grp->stacks  = new ulong[stacks * grp->depth];
+      grp->fill    = new uint16_t[stacks];
+      memset(grp->fill, 0, stacks * sizeof(uint16_t));
+      for (int op = 0; op < 2; op++) {
+         grp->hits[op] = new ulong[grp->depth];
+         memset(grp->hits[op], 0, grp->depth * sizeof(ulong));
+      }
+   }
+}
+
+StackDistanceSweep::~StackDistanceSweep()
+{
+   for (ulong g = 0; g < groups.size(); g++) {
+      delete [] groups[g]->stacks;
+      delete [] groups[g]->fill;
+      delete [] groups[g]->hits[0];
+      delete [] groups[g]->hits[1];
+      delete groups[g];
+   }
+}
+
+/*record the stack distance of block and move it to the top of its stack;
+  a miss reuses the topmost hole left by an invalidation, if any*/
+void StackDistanceSweep::touch(Group *g, ulong proc, uchar op, ulong block)
+{
+   ulong stack  = proc * g->sets + (block & (g->sets - 1));
+   ulong *s     = &g->stacks[stack * g->depth];
+   ulong fill   = g->fill[stack];
+
+   ulong d = 0, hole = fill;
+   while (d < fill && s[d] != block) {
+      if (s[d] == INVALID_TAG && hole == fill) hole = d;
+      d++;
+   }
+   if (d < fill) {
+      g->hits[op == 'w'][d]++;
+   }
+   else if (hole < fill) {
+      d = hole;
+   }
+   else if (fill < g->depth) {
+      g->fill[stack] = fill + 1;
+   }
+   else {
+      d = fill - 1;   // deeper than any simulated associativity: drop the LRU block
+   }
+   memmove(&s[1], &s[0], d * sizeof(ulong));
+   s[0] = block;
+}
+
+/*invalidate: keep the position, like an invalid way*/
+void StackDistanceSweep::invalidateBlock(Group *g, ulong proc, ulong block)
+{
+   ulong stack  = proc * g->sets + (block & (g->sets - 1));
+   ulong *s     = &g->stacks[stack * g->depth];
+   ulong fill   = g->fill[stack];
+
+   for (ulong d = 0; d < fill; d++) {
+      if (s[d] == block) {
+         s[d] = INVALID_TAG;
+         return;
+      }
+   }
+}
+
+void StackDistanceSweep::access(ulong proc, uchar op, ulong addr)
+{
+   if (op == 'w') writes++;
+   else           reads++;
+
+   for (ulong g = 0; g < groups.size(); g++) {
+      Group *grp  = groups[g];
+      ulong block = addr >> grp->log2Blk;
+      touch(grp, proc, op, block);
+      if (invalidate && op == 'w') {
+         for (ulong p = 0; p < numProcs; p++) {
+            if (p != proc) invalidateBlock(grp, p, block);
+         }
+      }
+   }
+}
+
+void StackDistanceSweep::printCSV(FILE *fp)
+{
+   fprintf(fp, "cache_size,assoc,block_size,sets,reads,read_misses,writes,write_misses,miss_rate\n");
+   for (ulong i = 0; i < configs.size(); i++) {
+      const Config &c = configs[i];
+      ulong readHits = 0, writeHits = 0;
+      for (ulong d = 0; d < c.assoc; d++) {
+         readHits  += c.group->hits[0][d];
+         writeHits += c.group->hits[1][d];
+      }
+      ulong misses = (reads - readHits) + (writes - writeHits);
+      fprintf(fp, "%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.2f%%\n", c.size, c.assoc, c.blockSize, c.group->sets,
+              reads, reads - readHits, writes, writes - writeHits,
+              (reads + writes) ? 100.0 * misses / (reads + writes) : 0.0);
+   }
+}
+
+bool parseSizeList(const char *str, vector<ulong> &out)
+{
+   out.clear();
+   while (*str != '\0') {
+      char *end;
+      ulong v = strtoul(str, &end, 0);
+      if (end == str || v == 0 || (*end != ',' && *end != '\0')) return false;
+      out.push_back(v);
+      str = (*end == ',') ? end + 1 : end;
+   }
+   return !out.empty();
+}
@@ -0,0 +1,70 @@
+/*******************************************************
+                          sweep.h
+********************************************************/
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include "cache.h"
+
+/*
+Miss counts of a whole grid of L1 geometries from one pass over a trace,
+using per-set LRU stack distances (Mattson et al.).
+
+For a fixed block size and number of sets, an access hits in an A-way LRU
+cache exactly when the block is among the A most recently used blocks of
+its set. So one LRU stack per (core, set), kept as deep as the largest
+associativity that shares that set count, yields the misses of every such
+configuration: misses(A) = accesses - sum of hits at distance < A.
+
+With invalidate set, a write leaves a hole (INVALID_TAG) at the block's
+position in the other cores' stacks, i.e. a plain write-invalidate protocol,
+and the next miss in that set fills the hole instead of pushing the LRU
+block out, like a fill into an invalid way. This is exact without
+invalidations and for direct mapped caches. Otherwise a hit below a hole
+moves the hole down the stack, while a cache too small to hold the hit block
+would have filled the hole instead, so counts can differ by a fraction of a
+percent from a full MESI simulation.
+*/
+class StackDistanceSweep
+{
+protected:
+   // all configurations with the same block size and number of sets
+   struct Group {
+      ulong log2Blk, sets, depth;
+      ulong *stacks;       // [core][set][depth] block numbers, MRU first
+      uint16_t *fill;      // [core][set] valid entries in each stack
+      ulong *hits[2];      // read / write hits per stack distance
+   };
+   struct Config {
+      ulong size, assoc, blockSize;
+      Group *group;
+   };
+
+   ulong numProcs;
+   bool invalidate;
+   ulong reads, writes;
+   std::vector<Group *> groups;
+   std::vector<Config> configs;
+
+   void touch(Group *g, ulong proc, uchar op, ulong block);
+   void invalidateBlock(Group *g, ulong proc, ulong block);
+
+public:
+   StackDistanceSweep(ulong procs, const std::vector<ulong> &sizes, const std::vector<ulong> &assocs,
+                      const std::vector<ulong> &blocks, bool inval);
+   ~StackDistanceSweep();
+
+   void access(ulong proc, uchar op, ulong addr);
+   ulong getNumConfigs()   { return configs.size(); }
+   // One CSV row per configuration, misses summed over all cores
+   void printCSV(FILE *fp);
+};
+
+// Parse a comma separated list of positive integers, false on a bad entry
+bool parseSizeList(const char *, std::vector<ulong> &);
+
+#endif
@@ -0,0 +1,283 @@
+/*******************************************************
+                          system.h
+********************************************************/
+
+#ifndef SYSTEM_H
+#define SYSTEM_H
+
+#include <stdio.h>
+#include <string.h>
+#include "cache.h"
+#include "directory.h"
+#include "trace.h"
+#include "timing.h"
+#include "llc.h"
+#include "classify.h"
+#include "sharing.h"
+#include "events.h"
+#include "protocol.h"
+
+// Configuration of the simulated multiprocessor
+struct SimConfig {
+   ulong cacheSize, assoc, blockSize, numProcs;
+   ulong protocol;      // PROTO_MSI .. PROTO_FIREFLY
+   int replacement;
+   bool snoopFilter;
+   bool timing;         // attach a BusTimer
+   BusLatencies latency;
+   ulong llcSize, llcAssoc;   // 0: no shared LLC
+   int llcMode;
+   ulong clusterSize;         // cores per snooping cluster, 0: one flat bus
+   bool classifyMisses;       // attach a MissClassifier to every cache
+   bool falseSharing;         // attach a SharingDetector
+   EventLog *events;          // log of the run's events, NULL: no event tracing
+   bool checkpoint;           // the cache state will be saved during the run
+   ulong samplePeriod, sampleWindow;   // sampling: window of every period accesses in detail, 0: all
+};
+
+/*
+The private caches of all cores and the bus connecting them, specialized
+for one protocol so the per-access path has no protocol checks.
+*/
+template <class P>
+struct CacheSystem {
+   ProtocolCache<P> **caches;
+   ulong numProcs;
+   SharerDirectory *directory;   // NULL: broadcast every transaction
+   ulong clusterSize;            // 0: one flat bus
+   BusTimer *timer;              // NULL: functional simulation only
+   LastLevelCache *llc;          // NULL: every L1 miss goes to memory
+   SharingDetector *sharing;     // NULL: no false-sharing analysis
+   EventLog *events;             // NULL: no event tracing
+};
+
+template <class P>
+CacheSystem<P> *createSystem(const SimConfig &cfg)
+{
+   CacheSystem<P> *sys = new CacheSystem<P>;
+   sys->caches    = new ProtocolCache<P>*[cfg.numProcs];
+   sys->numProcs  = cfg.numProcs;
+   sys->directory = NULL;
+   sys->timer     = cfg.timing ? new BusTimer(cfg.numProcs, cfg.latency) : NULL;
+   sys->llc       = NULL;
+   sys->sharing   = cfg.falseSharing ? new SharingDetector(cfg.blockSize) : NULL;
+   sys->events    = cfg.events;
+   if (cfg.llcSize != 0) {
+      sys->llc = new LastLevelCache(cfg.llcSize, cfg.llcAssoc, cfg.blockSize, cfg.llcMode, cfg.numProcs, cfg.replacement);
+   }
+   for (ulong i = 0; i < cfg.numProcs; i++) {
+      sys->caches[i] = new ProtocolCache<P>(cfg.cacheSize, cfg.assoc, cfg.blockSize, cfg.replacement);
+      if (cfg.classifyMisses) sys->caches[i]->attachClassifier(new MissClassifier(sys->caches[i]->getNumLines()));
+      if (cfg.falseSharing)   sys->caches[i]->attachSharingDetector(sys->sharing);
+      if (cfg.events != NULL) sys->caches[i]->attachEventLog(cfg.events, i);
+   }
+   // clusters are linked by a filter that knows which clusters hold a block,
+   // derived here from the per-core snoop filter
+   sys->clusterSize = cfg.clusterSize;
+   if (cfg.snoopFilter || cfg.clusterSize != 0) {
+      sys->directory = new SharerDirectory(cfg.numProcs, sys->caches[0]->getNumLines());
+      for (ulong i = 0; i < cfg.numProcs; i++) {
+         sys->caches[i]->attachDirectory(sys->directory, i);
+         sys->caches[i]->setClustered(cfg.clusterSize != 0);
+      }
+   }
+   return sys;
+}
+
+// Free a system built by createSystem; the event log belongs to the caller
+template <class P>
+void destroySystem(CacheSystem<P> *sys)
+{
+   for (ulong i = 0; i < sys->numProcs; i++) delete sys->caches[i];
+   delete [] sys->caches;
+   delete sys->directory;
+   delete sys->timer;
+   delete sys->llc;
+   delete sys->sharing;
+   delete sys;
+}
+
+/*
+Remove a block evicted from an inclusive LLC from every L1, on behalf of proc
+*/
+template <class P>
+void backInvalidate(CacheSystem<P> *sys, ulong proc, ulong victim)
+{
+   if (victim == NO_VICTIM) return;
+   for (ulong i = 0; i < sys->numProcs; i++) {
+      bool dirty;
+      if (sys->caches[i]->backInvalidate(victim, &dirty)) sys->llc->backInvalidated(proc, dirty);
+   }
+}
+
+/*
+Pass the traffic of one access that leaves the L1s to the shared LLC: the
+requester's victim, memory updates by flushing snoopers, the fill itself
+unless another L1 supplied the block, and the write-through of a BusUpd
+for protocols that update memory with it
+*/
+template <class P>
+void accessLLC(CacheSystem<P> *sys, ulong proc, ulong addr, int bus, bool flushed, long flusher)
+{
+   ulong victim;
+   bool dirty;
+   if (sys->caches[proc]->getEvicted(&victim, &dirty)) {
+      backInvalidate(sys, proc, sys->llc->evict(proc, victim, dirty));
+   }
+   if (flusher >= 0) {
+      backInvalidate(sys, flusher, sys->llc->writeBack(flusher, addr));
+   }
+   if ((bus & (BUS_RD | BUS_RDX)) && !flushed) {
+      backInvalidate(sys, proc, sys->llc->read(proc, addr));
+   }
+   if (P::writeThrough && (bus & BUS_UPD)) {
+      backInvalidate(sys, proc, sys->llc->writeBack(proc, addr));
+   }
+}
+
+/*
+Propagate one trace access to the requesting cache and let the other
+caches snoop the resulting bus transaction. With a snoop filter only the
+caches that actually hold the block are snooped; with clusters that is
+also exact, since the other cores of a cluster ignore the broadcast, and
+only the traffic counters model the two bus levels. With a bus timer the
+transaction is then timed, and with a shared LLC its traffic below the
+L1s is passed on.
+*/
+template <class P>
+inline void simulateAccess(CacheSystem<P> *sys, ulong proc, uchar op, ulong addr)
+{
+   ProtocolCache<P> **cacheArray = sys->caches;
+   ulong num_processors = sys->numProcs;
+   if (sys->events != NULL) sys->events->beginAccess(proc, addr);
+
+   // a silent hit to the core's last block: nothing for the others to snoop;
+   // a traced access takes the full path so its events are recorded
+   if ((sys->events == NULL || !sys->events->isActive()) && cacheArray[proc]->fastAccess(addr, op)) {
+      if (sys->timer != NULL) sys->timer->hit(proc);
+      return;
+   }
+
+   int brdcastSig;
+   bool flushed  = false;
+   long flusher  = -1;   // snooper that also updated memory
+   ulong writeBacks = cacheArray[proc]->getWB();
+
+   if (sys->directory != NULL) {
+      // other cores holding the block
+      uint64_t sharers[MAX_TRACE_CORES / 64];
+      ulong numWords = sys->directory->getNumWords();
+      bool shared    = false;
+      if (sys->directory->getSharers(cacheArray[proc]->getBlock(addr), sharers)) {
+         sharers[proc / 64] &= ~(((uint64_t)1) << (proc % 64));
+         for (ulong w = 0; w < numWords; w++) shared |= (sharers[w] != 0);
+      }
+      brdcastSig = cacheArray[proc]->Access(addr, op, shared);
+      if (sys->clusterSize != 0 && brdcastSig != BUS_NONE) {
+         // the local bus carries every transaction; it is forwarded to each
+         // other cluster holding the block and goes out on that cluster's bus
+         ulong home = proc / sys->clusterSize, last = home, remote = 0;
+         for (ulong w = 0; shared && w < numWords; w++) {
+            for (uint64_t bits = sharers[w]; bits != 0; bits &= bits - 1) {
+               ulong cluster = (w * 64 + __builtin_ctzll(bits)) / sys->clusterSize;
+               if (cluster != home && cluster != last) remote++;
+               last = cluster;
+            }
+         }
+         cacheArray[proc]->ClusterTrafficInc(1 + remote, remote);
+      }
+      for (ulong w = 0; shared && w < numWords; w++) {
+         for (uint64_t bits = sharers[w]; bits != 0; bits &= bits - 1) {
+            ulong i = w * 64 + __builtin_ctzll(bits);
+            uint applied = cacheArray[i]->Snoop(addr, op, brdcastSig);
+            flushed |= (applied & INC_FLUSH) != 0;
+            if (applied & INC_WB) flusher = i;
+         }
+      }
+   }
+   else {
+      // propagate request down through memory hierarchy
+      // by calling cachesArray[processor#]->Access(...)
+      bool C = false;
+      if (P::usesSharedSignal) {
+         for (ulong i=0; i < num_processors; i++) {
+            if (i != proc && cacheArray[i]->findLine(addr) != NO_LINE) {
+               C = true;
+               break;
+            }
+         }
+      }
+      brdcastSig = cacheArray[proc]->Access(addr, op, C);
+      for (ulong i=0; i < num_processors; i++) {
+         if (i != proc) {
+            uint applied = cacheArray[i]->Snoop(addr, op, brdcastSig);
+            flushed |= (applied & INC_FLUSH) != 0;
+            if (applied & INC_WB) flusher = i;
+         }
+      }
+   }
+
+   if (sys->llc != NULL) {
+      accessLLC(sys, proc, addr, brdcastSig, flushed, flusher);
+   }
+   if (sys->timer != NULL) {
+      sys->timer->access(proc, brdcastSig, flushed, cacheArray[proc]->getWB() != writeBacks);
+   }
+}
+
+// Other cores holding the block of addr according to the snoop filter
+template <class P>
+inline void otherSharers(CacheSystem<P> *sys, ulong proc, ulong addr, uint64_t *sharers)
+{
+   ulong numWords = sys->directory->getNumWords();
+   if (!sys->directory->getSharers(sys->caches[proc]->getBlock(addr), sharers)) {
+      memset(sharers, 0, numWords * sizeof(uint64_t));
+   }
+   sharers[proc / 64] &= ~(((uint64_t)1) << (proc % 64));
+}
+
+/*
+Functional warming between sampling windows: the same cache and coherence
+state changes as simulateAccess, but the shared line is only computed when
+the transition depends on it, only an actual bus transaction is snooped,
+and nothing is counted, timed or passed to the analyses.
+*/
+template <class P>
+inline void warmAccess(CacheSystem<P> *sys, ulong proc, uchar op, ulong addr)
+{
+   ProtocolCache<P> **cacheArray = sys->caches;
+   uint64_t sharers[MAX_TRACE_CORES / 64];
+   bool known = false;   // sharers holds the other cores caching the block
+
+   bool C = false;
+   if (P::usesSharedSignal && cacheArray[proc]->needsShared(addr, op)) {
+      if (sys->directory != NULL) {
+         otherSharers(sys, proc, addr, sharers);
+         known = true;
+         for (ulong w = 0; w < sys->directory->getNumWords(); w++) C |= (sharers[w] != 0);
+      }
+      else {
+         for (ulong i = 0; i < sys->numProcs && !C; i++) {
+            C = (i != proc && cacheArray[i]->findLine(addr) != NO_LINE);
+         }
+      }
+   }
+   int bus = cacheArray[proc]->warmAccess(addr, op, C);
+   if (bus == BUS_NONE) return;
+
+   if (sys->directory != NULL) {
+      if (!known) otherSharers(sys, proc, addr, sharers);
+      for (ulong w = 0; w < sys->directory->getNumWords(); w++) {
+         for (uint64_t bits = sharers[w]; bits != 0; bits &= bits - 1) {
+            cacheArray[w * 64 + __builtin_ctzll(bits)]->warmSnoop(addr, bus);
+         }
+      }
+   }
+   else {
+      for (ulong i = 0; i < sys->numProcs; i++) {
+         if (i != proc) cacheArray[i]->warmSnoop(addr, bus);
+      }
+   }
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*******************************************************
+                     test_sharing.cc
+********************************************************/
+
+/*
+Checks that pruning the per-block table of the false-sharing detector keeps
+the worst offenders, also when most blocks tie (no false-sharing events, or
+all the same count), and that the report still lists them.
+
+usage: ./test_sharing
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include "../sharing.h"
+using namespace std;
+
+const ulong HOT_BLOCKS = 16;
+const ulong BLOCK_SIZE = 64;
+
+class TestDetector : public SharingDetector
+{
+public:
+   TestDetector() : SharingDetector(BLOCK_SIZE) {}
+   bool tracks(ulong block)   { return blocks.count(block) != 0; }
+   ulong tracked()            { return blocks.size(); }
+};
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+   if (!ok) {
+      printf("FAIL %s\n", what);
+      failures++;
+   }
+}
+
+// printStats output of a detector
+static string report(TestDetector &d)
+{
+   fflush(stdout);
+   FILE *tmp = tmpfile();
+   int saved = dup(1);
+   dup2(fileno(tmp), 1);
+   d.printStats();
+   fflush(stdout);
+   dup2(saved, 1);
+   close(saved);
+
+   string text;
+   char line[256];
+   rewind(tmp);
+   while (fgets(line, sizeof(line), tmp) != NULL) text += line;
+   fclose(tmp);
+   return text;
+}
+
+// Hot blocks 0..HOT_BLOCKS-1 get 100+b false events each, then enough
+// filler blocks with the given false-event count to force several prunes
+static void run(const char *name, ulong fillerFalse)
+{
+   TestDetector d;
+   for (ulong b = 0; b < HOT_BLOCKS; b++) {
+      for (ulong n = 0; n < 100 + b; n++) d.record(SHARE_INV, false, b);
+   }
+   for (ulong b = HOT_BLOCKS; b < HOT_BLOCKS + 3 * SHARING_BLOCK_LIMIT; b++) {
+      d.record(SHARE_INV, true, b);
+      for (ulong n = 0; n < fillerFalse; n++) d.record(SHARE_UPD, false, b);
+   }
+
+   char what[128];
+   snprintf(what, sizeof(what), "%s: table bounded", name);
+   check(d.tracked() <= SHARING_BLOCK_LIMIT, what);
+   for (ulong b = 0; b < HOT_BLOCKS; b++) {
+      snprintf(what, sizeof(what), "%s: hot block %lu kept", name, b);
+      check(d.tracks(b), what);
+   }
+
+   // the report lists the FALSE_SHARING_TOP hottest blocks, hottest first
+   string text = report(d);
+   size_t last = 0;
+   for (ulong i = 0; i < FALSE_SHARING_TOP; i++) {
+      ulong b = HOT_BLOCKS - 1 - i;
+      char line[64];
+      snprintf(line, sizeof(line), "block 0x%lx: %lu false", b * BLOCK_SIZE, 100 + b);
+      size_t at = text.find(line);
+      snprintf(what, sizeof(what), "%s: block %lu reported in rank %lu", name, b, i + 1);
+      check(at != string::npos && at >= last, what);
+      if (at != string::npos) last = at;
+   }
+}
+
+// Every block has the same single false-sharing event: a prune must keep
+// half of them, not drop the whole table, so the report is not empty
+static void runAllTied()
+{
+   TestDetector d;
+   for (ulong b = 0; b <= SHARING_BLOCK_LIMIT; b++) d.record(SHARE_ITV, false, b);
+   check(d.tracked() == (SHARING_BLOCK_LIMIT + 1) - (SHARING_BLOCK_LIMIT + 1) / 2, "all tied: half the table kept");
+
+   string text = report(d);
+   ulong listed = 0;
+   for (size_t at = text.find("block 0x"); at != string::npos; at = text.find("block 0x", at + 1)) listed++;
+   check(listed == FALSE_SHARING_TOP, "all tied: report lists the top blocks");
+}
+
+int main()
+{
+   run("zero-count filler", 0);
+   run("tied filler", 1);
+   runAllTied();
+   printf("%s\n", failures == 0 ? "test_sharing: OK" : "test_sharing: FAILED");
+   return failures == 0 ? 0 : 1;
+}
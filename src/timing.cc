@@ -0,0 +1,155 @@
+/*******************************************************
+                          timing.cc
+********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+#include "protocol.h"
+
+BusTimer::BusTimer(ulong procs, const BusLatencies &latencies)
+{
+   lat      = latencies;
+   numProcs = procs;
+   coreCycles     = new ulong[numProcs];
+   coreMisses     = new ulong[numProcs];
+   coreMissCycles = new ulong[numProcs];
+   coreWaitCycles = new ulong[numProcs];
+   memset(coreCycles, 0, numProcs * sizeof(ulong));
+   memset(coreMisses, 0, numProcs * sizeof(ulong));
+   memset(coreMissCycles, 0, numProcs * sizeof(ulong));
+   memset(coreWaitCycles, 0, numProcs * sizeof(ulong));
+   busEnd = busBusy = transactions = 0;
+}
+
+void BusTimer::reset()
+{
+   memset(coreCycles, 0, numProcs * sizeof(ulong));
+   memset(coreMisses, 0, numProcs * sizeof(ulong));
+   memset(coreMissCycles, 0, numProcs * sizeof(ulong));
+   memset(coreWaitCycles, 0, numProcs * sizeof(ulong));
+   busy.clear();
+   busEnd = busBusy = transactions = 0;
+}
+
+BusTimer::~BusTimer()
+{
+   delete [] coreCycles;
+   delete [] coreMisses;
+   delete [] coreMissCycles;
+   delete [] coreWaitCycles;
+}
+
+// Windows ending before every core's clock can never be hit again
+const ulong PRUNE_INTERVAL = 4096;
+
+ulong BusTimer::acquireBus(ulong t, ulong occupancy)
+{
+   transactions++;
+   if (occupancy == 0) return t;
+
+   ulong start = t;
+   std::map<ulong, ulong>::iterator it = busy.upper_bound(start);
+   if (it != busy.begin()) {
+      std::map<ulong, ulong>::iterator prev = it;
+      --prev;
+      if (prev->second > start) start = prev->second;
+   }
+   // slide past every booked window that overlaps [start, start + occupancy)
+   for (; it != busy.end() && it->first < start + occupancy; ++it) {
+      if (it->second > start) start = it->second;
+   }
+   busy[start] = start + occupancy;
+   busBusy += occupancy;
+   if (start + occupancy > busEnd) busEnd = start + occupancy;
+
+   if (transactions % PRUNE_INTERVAL == 0) {
+      ulong oldest = coreCycles[0];
+      for (ulong i = 1; i < numProcs; i++) {
+         if (coreCycles[i] < oldest) oldest = coreCycles[i];
+      }
+      while (!busy.empty() && busy.begin()->second <= oldest) busy.erase(busy.begin());
+   }
+   return start;
+}
+
+void BusTimer::access(ulong proc, int bus, bool flushed, bool writeBack)
+{
+   ulong t = coreCycles[proc] + lat.hit;
+
+   if (writeBack) acquireBus(t, 2 * lat.bus);
+
+   if (bus == BUS_NONE) {
+      coreCycles[proc] = t;
+      return;
+   }
+
+   bool fill = (bus & (BUS_RD | BUS_RDX)) != 0;
+   // request phase, then a data phase for a block or an updated word
+   ulong occupancy = lat.bus;
+   if (fill)           occupancy += lat.bus;
+   if (bus & BUS_UPD)  occupancy += lat.bus;
+   ulong start = acquireBus(t, occupancy);
+
+   ulong done = start + occupancy;
+   if (fill)           done += flushed ? lat.flush : lat.memory;
+   if (bus & BUS_UPD)  done += lat.update;
+
+   coreWaitCycles[proc] += start - t;
+   if (fill) {
+      coreMisses[proc]++;
+      coreMissCycles[proc] += done - coreCycles[proc];
+   }
+   coreCycles[proc] = done;
+}
+
+ulong BusTimer::getTotalCycles()
+{
+   ulong total = busEnd;
+   for (ulong i = 0; i < numProcs; i++) {
+      if (coreCycles[i] > total) total = coreCycles[i];
+   }
+   return total;
+}
+
+void BusTimer::printCoreStats(ulong proc, int line)
+{
+   printf("%02d. number of execution cycles:                 %lu\n", line, coreCycles[proc]);
+   printf("%02d. average miss latency:                       %.2f\n", line + 1,
+          coreMisses[proc] ? (double) coreMissCycles[proc] / coreMisses[proc] : 0.0);
+   printf("%02d. number of bus wait cycles:                  %lu\n", line + 2, coreWaitCycles[proc]);
+}
+
+void BusTimer::printBusStats()
+{
+   ulong total = getTotalCycles();
+   printf("============ Bus timing ============\n");
+   printf("total execution cycles:                         %lu\n", total);
+   printf("bus transactions:                               %lu\n", transactions);
+   printf("bus busy cycles:                                %lu\n", busBusy);
+   printf("bus utilization:                                %.2f%%\n", total ? 100.0 * busBusy / total : 0.0);
+}
+
+BusLatencies defaultLatencies()
+{
+   BusLatencies lat;
+   lat.hit    = 1;
+   lat.memory = 100;
+   lat.flush  = 20;
+   lat.update = 10;
+   lat.bus    = 2;
+   return lat;
+}
+
+bool parseLatencies(const char *str, BusLatencies &lat)
+{
+   ulong *fields[] = {&lat.hit, &lat.memory, &lat.flush, &lat.update, &lat.bus};
+   for (int f = 0; f < 5; f++) {
+      char *end;
+      ulong v = strtoul(str, &end, 0);
+      if (end == str || *end != (f < 4 ? ',' : '\0')) return false;
+      *fields[f] = v;
+      str = end + 1;
+   }
+   return true;
+}
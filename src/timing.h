@@ -0,0 +1,73 @@
+/*******************************************************
+                          timing.h
+********************************************************/
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdio.h>
+#include <map>
+#include "cache.h"
+
+// Latencies in cycles
+struct BusLatencies {
+   ulong hit;       // tag check of every access
+   ulong memory;    // fetch of a block from memory
+   ulong flush;     // cache-to-cache transfer of a flushed block
+   ulong update;    // BusUpd of a word to the other sharers
+   ulong bus;       // one bus phase (arbitration + address, or data)
+};
+
+/*
+Optional timing layer around the functional simulation: a shared
+split-transaction bus with one local clock per core.
+
+Every access costs a hit; a bus transaction then waits for the bus,
+holds it for its request phase (plus a data phase if a block or a word is
+transferred) and releases it while memory or the supplying cache works, so
+other requests can overlap with that latency. The cores' clocks drift apart
+as the trace interleaves them, so the bus keeps a calendar of busy windows
+and a request gets the first idle window at or after the cycle its core
+issues it: a core only waits when the bus is actually busy at that time.
+Dirty victims are written back through a write buffer: they occupy the bus
+but do not stall the core.
+*/
+class BusTimer
+{
+protected:
+   BusLatencies lat;
+   ulong numProcs;
+   ulong *coreCycles, *coreMisses, *coreMissCycles, *coreWaitCycles;
+   std::map<ulong, ulong> busy;   // start -> end of the booked bus windows
+   ulong busEnd, busBusy, transactions;
+
+   // book the first idle window of occupancy cycles from cycle t, returns its start
+   ulong acquireBus(ulong t, ulong occupancy);
+
+public:
+   BusTimer(ulong procs, const BusLatencies &latencies);
+   ~BusTimer();
+
+   // An access of proc that caused no bus transaction
+   void hit(ulong proc)          { coreCycles[proc] += lat.hit; }
+   // An access of proc that issued bus (a BUS_* mask, possibly BUS_NONE);
+   // flushed: another cache supplied the block, writeBack: a dirty victim was evicted
+   void access(ulong proc, int bus, bool flushed, bool writeBack);
+
+   ulong getCycles(ulong proc)   { return coreCycles[proc]; }
+   ulong getWaitCycles(ulong proc) { return coreWaitCycles[proc]; }
+   ulong getTotalCycles();
+   // Restart every clock and the bus at cycle 0
+   void reset();
+
+   // Timing lines appended to the statistics of one cache, and the bus summary
+   void printCoreStats(ulong proc, int firstLine);
+   void printBusStats();
+};
+
+// Parse "hit,memory,flush,update,bus" into lat, false on a malformed list
+bool parseLatencies(const char *, BusLatencies &lat);
+// Defaults used by --timing
+BusLatencies defaultLatencies();
+
+#endif
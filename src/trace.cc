@@ -0,0 +1,358 @@
+/*******************************************************
+                          trace.cc
+********************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "trace.h"
+#include "generate.h"
+using namespace std;
+
+// Size of the text read buffer
+const ulong TEXT_BUF_SIZE = 1 << 22;
+// Refill before a line could straddle the end of the buffer
+const ulong MAX_LINE_LEN  = 256;
+
+TraceReader *TraceReader::open(const char *fname)
+{
+   if (strncmp(fname, GENERATOR_PREFIX, strlen(GENERATOR_PREFIX)) == 0) {
+      return SyntheticTraceReader::create(fname + strlen(GENERATOR_PREFIX));
+   }
+   int fd = (strcmp(fname, "-") == 0) ? 0 : ::open(fname, O_RDONLY);
+   if (fd < 0) return NULL;
+
+   // peek at the header; pipes cannot be rewound, so keep what was read
+   char head[sizeof(TraceHeader)];
+   ulong got = 0;
+   while (got < sizeof(head)) {
+      ssize_t n = read(fd, head + got, sizeof(head) - got);
+      if (n <= 0) break;
+      got += n;
+   }
+
+   if (got == sizeof(head) && memcmp(head, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0) {
+      struct stat st;
+      if (fstat(fd, &st) != 0) { ::close(fd); return NULL; }
+      void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (map == MAP_FAILED) return NULL;
+      madvise(map, st.st_size, MADV_SEQUENTIAL);
+      return new BinaryTraceReader(map, st.st_size);
+   }
+   return new TextTraceReader(fd, head, got);
+}
+
+/*
+Pipelined reader. head and tail only grow; slot i % PIPELINE_SLOTS is
+owned by the producer while head - tail < PIPELINE_SLOTS and by the
+consumer from the moment it is published until it is released. A side that
+goes to sleep counts itself in sleepers before it rechecks the ring under
+the lock, and a side that moves a counter wakes it if it sees the count, so
+no wakeup is lost.
+*/
+PipelinedTraceReader::PipelinedTraceReader(TraceReader *src)
+   : source(src), head(0), tail(0), stop(false), sleepers(0), taken(0)
+{
+   numCores = source->getNumCores();
+   copy     = !source->stableBatches();
+   for (ulong i = 0; i < PIPELINE_SLOTS; i++) {
+      slots[i]   = copy ? new TraceRecord[TRACE_BATCH] : NULL;
+      batches[i] = NULL;
+      counts[i]  = 0;
+   }
+   producer = std::thread(&PipelinedTraceReader::produce, this);
+}
+
+PipelinedTraceReader::~PipelinedTraceReader()
+{
+   stop.store(true);
+   notify();
+   producer.join();
+   for (ulong i = 0; i < PIPELINE_SLOTS; i++) delete [] slots[i];
+   delete source;
+}
+
+void PipelinedTraceReader::notify()
+{
+   if (sleepers.load() > 0) {
+      std::lock_guard<std::mutex> guard(lock);
+      wake.notify_all();
+   }
+}
+
+template <class Ready>
+void PipelinedTraceReader::await(Ready ready)
+{
+   for (ulong spin = 0; spin < PIPELINE_SPINS; spin++) {
+      if (ready()) return;
+   }
+   sleepers++;
+   std::unique_lock<std::mutex> guard(lock);
+   wake.wait(guard, ready);
+   sleepers--;
+}
+
+void PipelinedTraceReader::produce()
+{
+   const TraceRecord *batch;
+   for (ulong h = 0; ; h++) {
+      // wait for a free slot
+      await([&]() { return h - tail.load() < PIPELINE_SLOTS || stop.load(); });
+      if (stop.load(std::memory_order_relaxed)) return;
+      ulong n = source->nextBatch(&batch);
+      ulong slot = h % PIPELINE_SLOTS;
+      if (copy) {
+         memcpy(slots[slot], batch, n * sizeof(TraceRecord));
+         batch = slots[slot];
+      }
+      batches[slot] = batch;
+      counts[slot]  = n;
+      head.store(h + 1);
+      notify();
+      if (n == 0) return;   // an empty batch marks the end of the trace
+   }
+}
+
+ulong PipelinedTraceReader::nextBatch(const TraceRecord **batch)
+{
+   // hand the previous batch back to the producer
+   if (taken > tail.load(std::memory_order_relaxed)) {
+      tail.store(taken);
+      notify();
+   }
+   await([&]() { return head.load() != taken; });
+   ulong slot = taken % PIPELINE_SLOTS;
+   ulong n = counts[slot];
+   if (n == 0) return 0;    // keep returning the end marker
+   taken++;
+   *batch = batches[slot];
+   return n;
+}
+
+ulong OffsetTraceReader::nextBatch(const TraceRecord **batch)
+{
+   ulong n;
+   while ((n = source->nextBatch(batch)) > 0) {
+      if (n > skip) {
+         *batch += skip;
+         n      -= skip;
+         skip    = 0;
+         return n;
+      }
+      skip -= n;
+   }
+   return 0;
+}
+
+/*
+Text traces: "<proc> <op> <hex addr>" per line
+*/
+TextTraceReader::TextTraceReader(int f, const char *head, ulong len)
+{
+   fd      = f;
+   buf     = new char[TEXT_BUF_SIZE];
+   records = new TraceRecord[TRACE_BATCH];
+   memcpy(buf, head, len);
+   pos     = 0;
+   end     = len;
+   eof     = false;
+   line    = 0;
+}
+
+TextTraceReader::~TextTraceReader()
+{
+   if (fd > 0) ::close(fd);
+   delete [] buf;
+   delete [] records;
+}
+
+/*move the unread tail to the front and top the buffer up*/
+bool TextTraceReader::refill()
+{
+   if (eof) return false;
+   memmove(buf, buf + pos, end - pos);
+   end -= pos;
+   pos  = 0;
+   while (end < TEXT_BUF_SIZE) {
+      ssize_t n = read(fd, buf + end, TEXT_BUF_SIZE - end);
+      if (n <= 0) { eof = true; break; }
+      end += n;
+   }
+   return true;
+}
+
+static inline bool isSpace(char c)  { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+static inline int hexValue(char c)
+{
+   if (c >= '0' && c <= '9') return c - '0';
+   if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+   if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+   return -1;
+}
+
+/*decode one line; the caller guarantees a whole line is buffered. A core
+  or address that does not fit a TraceRecord ends the run: packing would
+  silently alias it*/
+bool TextTraceReader::parseRecord(TraceRecord *rec)
+{
+   while (pos < end && isSpace(buf[pos])) pos++;
+   if (pos == end) return false;
+
+   ulong proc = 0;
+   while (pos < end && buf[pos] >= '0' && buf[pos] <= '9') {
+      proc = proc * 10 + (buf[pos++] - '0');
+      if (proc > MAX_TRACE_CORES) proc = MAX_TRACE_CORES;   // saturate, no wrap
+   }
+   while (pos < end && isSpace(buf[pos])) pos++;
+   if (pos == end) return false;
+   uchar op = buf[pos++];
+   while (pos < end && isSpace(buf[pos])) pos++;
+   if (pos + 1 < end && buf[pos] == '0' && (buf[pos+1] == 'x' || buf[pos+1] == 'X')) pos += 2;
+   ulong addr = 0;
+   bool wide  = false;
+   int v;
+   while (pos < end && (v = hexValue(buf[pos])) >= 0) {
+      addr = (addr << 4) | v;
+      wide |= (addr > ADDR_MASK);
+      pos++;
+   }
+   line++;
+   if (proc >= MAX_TRACE_CORES || wide) {
+      printf("Trace line %lu: cores must be below %lu and addresses below 2^%d\n", line, MAX_TRACE_CORES, ADDR_BITS);
+      exit(1);
+   }
+   if (proc >= coreLimit) {
+      printf("Trace line %lu: core %lu, but only %lu processors are simulated\n", line, proc, coreLimit);
+      exit(1);
+   }
+   if (op != 'r' && op != 'w') {
+      printf("Trace line %lu: operation '%c' is neither r nor w\n", line, op);
+      exit(1);
+   }
+
+   *rec = TraceRecord::make(proc, op, addr);
+   return true;
+}
+
+ulong TextTraceReader::nextBatch(const TraceRecord **batch)
+{
+   ulong n = 0;
+   while (n < TRACE_BATCH) {
+      if (end - pos < MAX_LINE_LEN && !eof) refill();
+      if (!parseRecord(&records[n])) break;
+      n++;
+   }
+   *batch = records;
+   return n;
+}
+
+/*
+Binary traces: records are used in place from the mapping
+*/
+BinaryTraceReader::BinaryTraceReader(void *m, size_t size)
+{
+   map      = m;
+   mapSize  = size;
+   next     = 0;
+   const TraceHeader *hdr = (const TraceHeader *) map;
+   records    = (const TraceRecord *)((const char *) map + sizeof(TraceHeader));
+   numRecords = hdr->numRecords;
+   numCores   = hdr->numCores;
+   // never trust the header beyond what the file actually holds
+   ulong avail = (size - sizeof(TraceHeader)) / sizeof(TraceRecord);
+   if (numRecords > avail) numRecords = avail;
+}
+
+BinaryTraceReader::~BinaryTraceReader()
+{
+   munmap(map, mapSize);
+}
+
+ulong BinaryTraceReader::nextBatch(const TraceRecord **batch)
+{
+   ulong n = numRecords - next;
+   if (n > TRACE_BATCH) n = TRACE_BATCH;
+   // the header's core count is not trusted per record either
+   ulong top = 0;
+   for (ulong i = 0; i < n; i++) top = max(top, records[next + i].getProc());
+   if (n > 0 && top >= coreLimit) {
+      ulong i = 0;
+      while (records[next + i].getProc() < coreLimit) i++;
+      printf("Trace record %lu: core %lu, but only %lu processors are simulated\n", next + i, records[next + i].getProc(), coreLimit);
+      exit(1);
+   }
+   *batch = records + next;
+   next  += n;
+   return n;
+}
+
+/*
+Binary trace writer
+*/
+bool TraceWriter::open(const char *fname)
+{
+   fp = fopen(fname, "wb");
+   if (fp == NULL) return false;
+   records = new TraceRecord[TRACE_BATCH];
+   // placeholder header, rewritten once the counts are known
+   TraceHeader hdr;
+   memset(&hdr, 0, sizeof(hdr));
+   fwrite(&hdr, sizeof(hdr), 1, fp);
+   return true;
+}
+
+void TraceWriter::flush()
+{
+   fwrite(records, sizeof(TraceRecord), pending, fp);
+   pending = 0;
+}
+
+void TraceWriter::write(const TraceRecord &rec)
+{
+   records[pending++] = rec;
+   numRecords++;
+   if (rec.getProc() + 1 > numCores) numCores = rec.getProc() + 1;
+   if (pending == TRACE_BATCH) flush();
+}
+
+void TraceWriter::close()
+{
+   if (fp == NULL) return;
+   flush();
+   TraceHeader hdr;
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+   hdr.numCores   = numCores;
+   hdr.numRecords = numRecords;
+   fseek(fp, 0, SEEK_SET);
+   fwrite(&hdr, sizeof(hdr), 1, fp);
+   fclose(fp);
+   fp = NULL;
+   delete [] records;
+   records = NULL;
+}
+
+long convertTrace(const char *in, const char *out)
+{
+   TraceReader *reader = TraceReader::open(in);
+   if (reader == NULL) return -1;
+   TraceWriter writer;
+   if (!writer.open(out)) { delete reader; return -1; }
+
+   const TraceRecord *batch;
+   ulong n;
+   while ((n = reader->nextBatch(&batch)) > 0) {
+      for (ulong i = 0; i < n; i++) writer.write(batch[i]);
+   }
+   delete reader;
+   long count = writer.getNumRecords();
+   writer.close();
+   return count;
+}
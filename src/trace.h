@@ -0,0 +1,199 @@
+/*******************************************************
+                          trace.h
+********************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "cache.h"
+
+/*
+Binary trace layout (little endian):
+   TraceHeader, followed by numRecords packed 8-byte TraceRecords
+   record bits [63:49] core, [48] 1 if write, [47:0] byte address
+*/
+const char     TRACE_MAGIC[8]  = {'S','M','P','T','R','C','0','1'};
+const int      ADDR_BITS       = 48;
+const uint64_t ADDR_MASK       = (((uint64_t)1) << ADDR_BITS) - 1;
+const ulong    MAX_TRACE_CORES = 1 << (64 - ADDR_BITS - 1);
+
+struct TraceHeader {
+   char     magic[8];
+   uint32_t numCores;
+   uint32_t reserved;
+   uint64_t numRecords;
+};
+
+struct TraceRecord {
+   uint64_t bits;
+
+   ulong getProc() const   { return (ulong)(bits >> (ADDR_BITS + 1)); }
+   uchar getOp() const     { return ((bits >> ADDR_BITS) & 1) ? 'w' : 'r'; }
+   ulong getAddr() const   { return (ulong)(bits & ADDR_MASK); }
+
+   static TraceRecord make(ulong proc, uchar op, ulong addr) {
+      TraceRecord r;
+      r.bits = ((uint64_t)proc << (ADDR_BITS + 1)) | ((uint64_t)(op == 'w') << ADDR_BITS) | (addr & ADDR_MASK);
+      return r;
+   }
+};
+
+// Number of records handed out per batch
+const ulong TRACE_BATCH = 1 << 16;
+
+/*
+Reads a trace in either format. Binary traces are mmap'ed and batches point
+straight into the mapping; text traces are tokenized from a large read buffer
+into an internal batch. "-" reads a text trace from stdin, and a name
+starting with "gen:" generates a synthetic trace (see generate.h).
+*/
+class TraceReader
+{
+protected:
+   ulong coreLimit;     // records of a core at or above it are rejected
+
+public:
+   TraceReader() : coreLimit(MAX_TRACE_CORES) {}
+   virtual ~TraceReader() {}
+   // Point *batch at the next run of records, returns 0 at end of trace
+   virtual ulong nextBatch(const TraceRecord **batch) = 0;
+   // Number of cores declared by the trace, 0 if unknown (text traces)
+   virtual ulong getNumCores() { return 0; }
+   // True if batches stay valid until the reader is deleted, not only until
+   // the next call (records that live in a mapping)
+   virtual bool stableBatches() { return false; }
+
+   // Reject records of cores numbered n and up, which a run of n processors
+   // cannot simulate: the reader prints the offending record and exits
+   void limitCores(ulong n)   { coreLimit = n; }
+
+   // Detect the format of fname and open it, NULL on failure
+   static TraceReader *open(const char *fname);
+};
+
+class TextTraceReader : public TraceReader
+{
+protected:
+   int fd;
+   char *buf;
+   ulong pos, end;
+   bool eof;
+   TraceRecord *records;
+   ulong line;       // lines parsed so far, for diagnostics
+
+   bool refill();
+   bool parseRecord(TraceRecord *);
+
+public:
+   TextTraceReader(int, const char *, ulong);
+   ~TextTraceReader();
+   ulong nextBatch(const TraceRecord **);
+};
+
+class BinaryTraceReader : public TraceReader
+{
+protected:
+   void *map;
+   size_t mapSize;
+   const TraceRecord *records;
+   ulong numRecords, numCores, next;
+
+public:
+   BinaryTraceReader(void *, size_t);
+   ~BinaryTraceReader();
+   ulong nextBatch(const TraceRecord **);
+   ulong getNumCores()     { return numCores; }
+   bool stableBatches()    { return true; }
+};
+
+// Number of decoded batches the pipeline may run ahead of the simulator
+const ulong PIPELINE_SLOTS = 8;
+// Polls of the ring before a side blocks on the condition variable
+const ulong PIPELINE_SPINS = 256;
+
+/*
+Decodes another reader on a producer thread so I/O and parsing overlap with
+simulation. Batches go through a bounded single-producer/single-consumer
+ring of PIPELINE_SLOTS entries; the two sides only share the head and tail
+counters. A source with stable batches (a mapped binary trace) is passed
+through by pointer, any other is copied into the slot's buffer. A side that
+finds the ring full or empty polls it a few times and then sleeps until the
+other side moves. A batch returned by nextBatch stays valid until the next
+call, or as long as the source's batches if they are passed through.
+*/
+class PipelinedTraceReader : public TraceReader
+{
+protected:
+   TraceReader *source;
+   bool copy;                 // source batches do not outlive the next call
+   TraceRecord *slots[PIPELINE_SLOTS];
+   const TraceRecord *batches[PIPELINE_SLOTS];
+   ulong counts[PIPELINE_SLOTS];
+   std::atomic<ulong> head;   // batches produced
+   std::atomic<ulong> tail;   // batches released by the consumer
+   std::atomic<bool> stop;
+   std::atomic<int> sleepers; // sides waiting on wake
+   std::mutex lock;
+   std::condition_variable wake;
+   ulong taken;               // batches handed to the consumer
+   ulong numCores;
+   std::thread producer;
+
+   void produce();
+   void notify();
+   template <class Ready> void await(Ready ready);
+
+public:
+   PipelinedTraceReader(TraceReader *);
+   ~PipelinedTraceReader();
+   ulong nextBatch(const TraceRecord **);
+   ulong getNumCores()     { return numCores; }
+   // passed-through batches point into the source's mapping and outlive
+   // their slot; a copied batch lives in a slot that is reused
+   bool stableBatches()    { return copy ? false : source->stableBatches(); }
+};
+
+// Drops the first accesses of another reader, to resume at a trace offset
+class OffsetTraceReader : public TraceReader
+{
+protected:
+   TraceReader *source;
+   ulong skip;
+   ulong numCores;
+
+public:
+   OffsetTraceReader(TraceReader *src, ulong offset) : source(src), skip(offset) { numCores = src->getNumCores(); }
+   ~OffsetTraceReader()    { delete source; }
+   ulong nextBatch(const TraceRecord **);
+   ulong getNumCores()     { return numCores; }
+   bool stableBatches()    { return source->stableBatches(); }
+};
+
+// Writes a binary trace; the header is completed on close()
+class TraceWriter
+{
+protected:
+   FILE *fp;
+   TraceRecord *records;
+   ulong pending, numRecords, numCores;
+
+   void flush();
+
+public:
+   TraceWriter() : fp(NULL), records(NULL), pending(0), numRecords(0), numCores(0) {}
+   ~TraceWriter() { close(); }
+   bool open(const char *fname);
+   void write(const TraceRecord &);
+   void close();
+   ulong getNumRecords()   { return numRecords; }
+};
+
+// Convert a text trace into the binary format, returns the record count
+long convertTrace(const char *in, const char *out);
+
+#endif
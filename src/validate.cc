@@ -0,0 +1,296 @@
+/*******************************************************
+                          validate.cc
+********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "validate.h"
+#include "system.h"
+#include "trace.h"
+#include "protocol.h"
+using namespace std;
+
+// line 05, the miss rate, is the only statistic that is not a counter
+const int VAL_MISS_RATE = 4;
+
+static string trim(const char *s)
+{
+   while (*s == ' ' || *s == '\t') s++;
+   string t = s;
+   while (!t.empty() && strchr(" \t\r\n", t[t.size() - 1]) != NULL) t.erase(t.size() - 1);
+   return t;
+}
+
+// value of a "KEY: value" configuration line, false if line is not about key
+static bool configValue(const char *line, const char *key, string *value)
+{
+   size_t len = strlen(key);
+   if (strncmp(line, key, len) != 0) return false;
+   *value = trim(line + len);
+   return true;
+}
+
+bool parseReference(const char *path, ValReference &ref, string *error)
+{
+   FILE *fp = fopen(path, "r");
+   if (fp == NULL) {
+      *error = "cannot open";
+      return false;
+   }
+   ref.path = path;
+   ref.trace.clear();
+   ref.values.clear();
+   ref.cacheSize = ref.assoc = ref.blockSize = ref.numProcs = 0;
+   ref.protocol  = NUM_PROTOCOLS;
+
+   char line[256];
+   string value;
+   long cache = -1;
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      if      (configValue(line, "L1_SIZE:", &value))              ref.cacheSize = strtoul(value.c_str(), NULL, 10);
+      else if (configValue(line, "L1_ASSOC:", &value))             ref.assoc     = strtoul(value.c_str(), NULL, 10);
+      else if (configValue(line, "L1_BLOCKSIZE:", &value))         ref.blockSize = strtoul(value.c_str(), NULL, 10);
+      else if (configValue(line, "NUMBER OF PROCESSORS:", &value)) ref.numProcs  = strtoul(value.c_str(), NULL, 10);
+      else if (configValue(line, "COHERENCE PROTOCOL:", &value)) {
+         for (ulong p = 0; p < NUM_PROTOCOLS; p++) {
+            if (value == protocolName(p)) ref.protocol = p;
+         }
+      }
+      else if (configValue(line, "TRACE FILE:", &value)) {
+         size_t slash = value.rfind('/');
+         ref.trace = (slash == string::npos) ? value : value.substr(slash + 1);
+      }
+      else if (sscanf(line, "============ Simulation results (Cache %ld)", &cache) == 1) {
+         ref.values.resize((cache + 1) * VAL_FIELDS);
+      }
+      else if (cache >= 0 && line[0] >= '0' && line[0] <= '9') {
+         // "NN. label:   value"
+         int field = atoi(line) - 1;
+         char *dot = strchr(line, '.'), *colon = strrchr(line, ':');
+         if (field < 0 || field >= VAL_FIELDS || dot == NULL || colon == NULL || colon < dot) continue;
+         string label = trim(string(dot + 1, colon).c_str());
+         if (field == VAL_BUSUPGR && label != "number of BusUpgr") continue;   // e.g. cluster traffic
+         ref.labels[field] = label;
+         ref.values[cache * VAL_FIELDS + field] = trim(colon + 1);
+      }
+   }
+   fclose(fp);
+
+   if (ref.protocol == NUM_PROTOCOLS)                    *error = "unknown coherence protocol";
+   else if (ref.cacheSize == 0 || ref.assoc == 0 || ref.blockSize == 0 || ref.numProcs == 0) *error = "incomplete configuration";
+   else if (ref.trace.empty())                           *error = "no trace file";
+   else if (ref.values.size() != ref.numProcs * VAL_FIELDS) *error = "statistics do not match the number of processors";
+   else return true;
+   return false;
+}
+
+// Simulate the whole trace on a fresh system and format every cache's
+// statistics lines 01-11 the way printStats prints them (line 11 empty
+// for a protocol without upgrades)
+template <class P>
+static void simulateReference(const SimConfig &cfg, TraceReader *trace, vector<string> &values)
+{
+   CacheSystem<P> *sys = createSystem<P>(cfg);
+   const TraceRecord *batch;
+   ulong n;
+   while ((n = trace->nextBatch(&batch)) > 0) {
+      for (ulong i = 0; i < n; i++) simulateAccess(sys, batch[i].getProc(), batch[i].getOp(), batch[i].getAddr());
+   }
+
+   char text[32];
+   for (ulong i = 0; i < sys->numProcs; i++) {
+      ProtocolCache<P> *c = sys->caches[i];
+      ulong counts[VAL_FIELDS] = {
+         c->getReads(), c->getRM(), c->getWrites(), c->getWM(), 0, c->getWB(), c->getMemTx(),
+         P::updateBased ? c->getInterventions() : c->getInvalidations(),
+         c->getFlushes(),
+         P::updateBased ? c->getBusUpd() : c->getBusRdX(),
+         c->getBusUpgr()
+      };
+      for (int f = 0; f < VAL_FIELDS; f++) {
+         if (f == VAL_MISS_RATE)                   snprintf(text, sizeof(text), "%.2f%%", c->getMissRate());
+         else if (f == VAL_BUSUPGR && !P::upgrades) text[0] = '\0';
+         else                                      snprintf(text, sizeof(text), "%lu", counts[f]);
+         values.push_back(text);
+      }
+   }
+   destroySystem(sys);
+}
+
+void validatePair(const ValReference &ref, const char *tracePath, ValResult &result)
+{
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   result.status  = VAL_FAIL;
+   result.seconds = 0;
+   result.mismatches.clear();
+
+   TraceReader *trace = TraceReader::open(tracePath);
+   if (trace == NULL) {
+      result.note = string("cannot read trace ") + tracePath;
+      return;
+   }
+   if (trace->getNumCores() > ref.numProcs) {
+      result.note = "the trace has more cores than the reference processors";
+      delete trace;
+      return;
+   }
+   trace->limitCores(ref.numProcs);
+   SimConfig cfg = SimConfig();
+   cfg.cacheSize   = ref.cacheSize;
+   cfg.assoc       = ref.assoc;
+   cfg.blockSize   = ref.blockSize;
+   cfg.numProcs    = ref.numProcs;
+   cfg.protocol    = ref.protocol;
+   cfg.replacement = REPL_LRU;
+   cfg.events      = NULL;
+
+   vector<string> values;
+   switch (ref.protocol) {
+      case PROTO_MSI:     simulateReference<MSIProtocol>(cfg, trace, values);     break;
+      case PROTO_DRAGON:  simulateReference<DragonProtocol>(cfg, trace, values);  break;
+      case PROTO_MESI:    simulateReference<MESIProtocol>(cfg, trace, values);    break;
+      case PROTO_MOESI:   simulateReference<MOESIProtocol>(cfg, trace, values);   break;
+      case PROTO_FIREFLY: simulateReference<FireflyProtocol>(cfg, trace, values); break;
+   }
+   delete trace;
+
+   char line[256];
+   for (ulong k = 0; k < values.size(); k++) {
+      if (values[k] == ref.values[k] || (ref.values[k].empty() && k % VAL_FIELDS == VAL_BUSUPGR)) continue;
+      int field = k % VAL_FIELDS;
+      snprintf(line, sizeof(line), "cache %lu, %02d. %s: expected %s, got %s", k / VAL_FIELDS, field + 1,
+               ref.labels[field].c_str(), ref.values[k].c_str(), values[k].c_str());
+      result.mismatches.push_back(line);
+   }
+   if (result.mismatches.empty()) result.status = VAL_PASS;
+   result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// .val files of a directory in name order, or path itself if it is a file
+static void listReferences(const string &path, vector<string> &files)
+{
+   struct stat st;
+   DIR *dir;
+   if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || (dir = opendir(path.c_str())) == NULL) {
+      files.push_back(path);
+      return;
+   }
+   vector<string> names;
+   struct dirent *entry;
+   while ((entry = readdir(dir)) != NULL) {
+      string name = entry->d_name;
+      if (name.size() > 4 && name.compare(name.size() - 4, 4, ".val") == 0) names.push_back(name);
+   }
+   closedir(dir);
+   sort(names.begin(), names.end());
+   for (ulong i = 0; i < names.size(); i++) files.push_back(path + "/" + names[i]);
+}
+
+static string baseName(const string &path)
+{
+   size_t slash = path.rfind('/');
+   return (slash == string::npos) ? path : path.substr(slash + 1);
+}
+
+// Name of the optional manifest next to the references
+const char *VAL_MANIFEST = "traces.txt";
+
+/*
+Trace file name of a reference: the one the manifest in the reference's
+directory maps it to, for outputs whose TRACE FILE line is wrong, or else
+the one the TRACE FILE line names. Manifest lines are
+"<reference file name> <trace file name>", # starts a comment.
+*/
+static string traceName(const ValReference &ref)
+{
+   size_t slash = ref.path.rfind('/');
+   string dir  = (slash == string::npos) ? "." : ref.path.substr(0, slash);
+   string name = baseName(ref.path);
+   FILE *fp = fopen((dir + "/" + VAL_MANIFEST).c_str(), "r");
+   if (fp == NULL) return ref.trace;
+
+   string trace = ref.trace;
+   char line[512], file[256], mapped[256];
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      char *hash = strchr(line, '#');
+      if (hash != NULL) *hash = '\0';
+      if (sscanf(line, "%255s %255s", file, mapped) == 2 && name == file) trace = mapped;
+   }
+   fclose(fp);
+   return trace;
+}
+
+int validateAll(const vector<string> &paths, const char *traceDir, ulong jobs, FILE *out)
+{
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   vector<string> files;
+   for (ulong p = 0; p < paths.size(); p++) listReferences(paths[p], files);
+
+   vector<ValReference> refs(files.size());
+   vector<ValResult> results(files.size());
+   vector<string> traces(files.size());
+   vector<ulong> queued;
+   for (ulong r = 0; r < files.size(); r++) {
+      ValResult &res = results[r];
+      res.status  = VAL_SKIP;
+      res.seconds = 0;
+      for (ulong e = 0; e < r && res.note.empty(); e++) {
+         if (baseName(files[e]) == baseName(files[r])) res.note = "superseded by " + files[e];
+      }
+      if (!res.note.empty()) {
+         refs[r].path = files[r];
+         continue;
+      }
+      string error;
+      if (!parseReference(files[r].c_str(), refs[r], &error)) {
+         fprintf(out, "%s: %s\n", files[r].c_str(), error.c_str());
+         return -1;
+      }
+      refs[r].trace = traceName(refs[r]);
+      traces[r] = string(traceDir) + "/" + refs[r].trace;
+      if (access(traces[r].c_str(), R_OK) != 0) {
+         res.note = "no trace " + refs[r].trace + " in " + traceDir;
+         continue;
+      }
+      queued.push_back(r);
+   }
+
+   // every pair simulates its own system, so they run independently
+   if (jobs > queued.size()) jobs = queued.size();
+   atomic<ulong> next(0);
+   vector<thread> workers;
+   for (ulong t = 0; t < jobs; t++) {
+      workers.push_back(thread([&]() {
+         for (ulong q; (q = next++) < queued.size(); ) {
+            ulong r = queued[q];
+            validatePair(refs[r], traces[r].c_str(), results[r]);
+         }
+      }));
+   }
+   for (ulong t = 0; t < workers.size(); t++) workers[t].join();
+
+   ulong counts[3] = {0, 0, 0};
+   const char *status[] = {"PASS", "FAIL", "SKIP"};
+   for (ulong r = 0; r < files.size(); r++) {
+      const ValResult &res = results[r];
+      counts[res.status]++;
+      if (res.status == VAL_SKIP) {
+         fprintf(out, "SKIP %s: %s\n", files[r].c_str(), res.note.c_str());
+         continue;
+      }
+      fprintf(out, "%s %s (%s, %s) %.3f s\n", status[res.status], files[r].c_str(),
+              protocolName(refs[r].protocol), refs[r].trace.c_str(), res.seconds);
+      if (!res.note.empty()) fprintf(out, "   %s\n", res.note.c_str());
+      for (ulong m = 0; m < res.mismatches.size(); m++) fprintf(out, "   %s\n", res.mismatches[m].c_str());
+   }
+   fprintf(out, "%lu passed, %lu failed, %lu skipped in %.3f s\n", counts[VAL_PASS], counts[VAL_FAIL], counts[VAL_SKIP],
+           chrono::duration<double>(chrono::steady_clock::now() - start).count());
+   return counts[VAL_FAIL];
+}
@@ -0,0 +1,58 @@
+/*******************************************************
+                          validate.h
+********************************************************/
+
+#ifndef VALIDATE_H
+#define VALIDATE_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "cache.h"
+
+// Statistics lines 01-10 of every cache are compared, and line 11 when it
+// is the BusUpgr count of a protocol that issues upgrades
+const int VAL_FIELDS  = 11;
+const int VAL_BUSUPGR = 10;
+
+// One reference output (a .val file) and the run that produced it
+struct ValReference {
+   std::string path;
+   std::string trace;      // trace file name, without its directory
+   ulong cacheSize, assoc, blockSize, numProcs, protocol;
+   std::string labels[VAL_FIELDS];     // e.g. "number of read misses"
+   std::vector<std::string> values;    // [cache * VAL_FIELDS + line - 1], as printed, empty if absent
+};
+
+enum {
+   VAL_PASS = 0,
+   VAL_FAIL,
+   VAL_SKIP
+};
+
+struct ValResult {
+   int status;
+   std::string note;                      // why a pair was skipped
+   std::vector<std::string> mismatches;   // one line per differing field
+   double seconds;
+};
+
+// Read a reference output; false with *error set if it is not a valid one
+bool parseReference(const char *path, ValReference &ref, std::string *error);
+
+// Simulate the reference's configuration on tracePath (no optional
+// arguments) and compare every statistics line the reference holds
+void validatePair(const ValReference &ref, const char *tracePath, ValResult &result);
+
+/*
+Validate every reference in paths (.val files or directories of them)
+against the traces in traceDir, on up to jobs threads, and print one line
+per reference plus its mismatches to out. A reference with the file name of
+an earlier one (e.g. val/ after its revision val.v2/) is superseded and
+skipped, and so is one whose trace is missing. A traces.txt manifest next
+to the references can name the trace of a reference explicitly. Returns the number of
+failing references, or -1 if a reference cannot be read.
+*/
+int validateAll(const std::vector<std::string> &paths, const char *traceDir, ulong jobs, FILE *out);
+
+#endif